@@ -10,8 +10,16 @@
 
 //Includes
 #include <iostream>
+#include <stdio.h>
 #include <string>
 #include <vector>
+#include <math.h>
+
+const int cellpair_noimage=62;        /* image code of cell pairs without periodic shift */
+const int cellpair_nimages=125;       /* image codes ((nx+2)*5+ny+2)*5+nz+2 for shifts of -2..2 boxes */
+const int cellpair_imagebits=7;       /* low bits of a packed cell pair entry holding the image code */
+
+class ClusterList;
 
 class Atoms {
 
@@ -51,6 +59,12 @@ class Atoms {
      */
     inline void SetPotEnergy(double energy) { this->m_potenergy = energy; };
 
+    /**
+     * Set virial (sum of r_ij . f_ij over pairs)
+     * @param virial of atoms
+     */
+    inline void SetVirial(double virial) { this->m_virial = virial; };
+
     /**
      * Set position of atoms by index
      * @param idx Index of atom
@@ -81,6 +95,12 @@ class Atoms {
      */
     inline void SetTemp(double temp) { this->m_temperature = temp; };
 
+    /**
+     * Set pressure
+     * @param pressure
+     */
+    inline void SetPressure(double pressure) { this->m_pressure = pressure; };
+
     /**
      * Set radial cutoff value
      * @param radcut cutoff
@@ -88,31 +108,72 @@ class Atoms {
     inline void SetRadCut(double radcut) { this->m_radcut = radcut; };
 
     /**
-     * Set box size
+     * Set box size of a cubic box
      * @param box size
      */
-    inline void SetBoxSize(double boxsize) { this->m_boxsize = boxsize; };
+    inline void SetBoxSize(double boxsize) { this->SetBoxSize(boxsize, boxsize, boxsize); };
 
     /**
-     * Set number of pairs
+     * Set box: edge vectors a=(lx,0,0), b=(xy,ly,0) and c=(xz,yz,lz),
+     * centered at the origin. Non-zero tilts make the box triclinic.
+     * @param lx,ly,lz Box lengths
+     * @param xy,xz,yz Tilt factors
+     */
+     void SetBoxSize(double lx, double ly, double lz, double xy=0.0, double xz=0.0, double yz=0.0);
+
+    /**
+     * Set number of pairs (reserve memory: packed pair list)
      * @param npairs Number of pairs
+     * @return Standard error code
      */
-    inline void SetNPairs(int npairs) { this->m_npairs = npairs; };
+      bool SetNPairs(int npairs);
 
     /**
-     * Set number of cells (reserve memory: cells, pairlist)
+     * Set number of cells (reserve memory: cells)
      * @param ncells Number of cells
      * @return nidx for integrator class
      */
      int SetNCells(int ncells);
 
     /**
-     * Set item in pair list container
-     * @param idx Container index
-     * @param pair Pair index
+     * Set the order in which the force kernels traverse the cells (e.g.
+     * along a space-filling curve); takes effect at the next pruning
+     * @param order Permutation of the cells
+     * @return Standard error code
+     */
+      bool SetCellOrder(const std::vector<int> &order);
+
+    /**
+     * Prune the cell pairs by the bounding boxes of the atoms in each cell:
+     * pairs of empty cells or of boxes farther apart than the pair list
+     * cutoff are left out of the active pairs, and the full neighbor cell
+     * list is rebuilt from the active pairs. Active pairs are stored by
+     * first cell in traversal order. Atoms have to be sorted into
+     * their cells; the result stays valid while no atom moves by more than
+     * half the difference of pair list cutoff and cutoff.
+     * @param rlist Pair list cutoff: cutoff plus skin
+     * @return Standard error code
+     */
+      bool PruneCellPairs(double rlist);
+
+    /**
+     * Build the full neighbor cell list: every cell with itself and with the
+     * cells of all its active cell pairs in both directions, so that forces
+     * on the atoms of a cell can be computed without writing to other cells
+     * @return Standard error code
+     */
+      bool BuildCellNeighbors();
+
+    /**
+     * Set a cell pair. Pairs have to be set in order of their first cell,
+     * which is stored once per cell rather than per pair.
+     * @param idx Index of pair
+     * @param i First cell
+     * @param j Second cell, used at its position plus the shift of the image
+     * @param image Image code of the periodic shift of the second cell
      * @return Standard error code
      */
-      bool SetPairItem(int idx, int pair);
+      bool SetPair(int idx, int i, int j, int image);
 
     /**
      * Set cell index by index
@@ -131,6 +192,110 @@ class Atoms {
      */
       bool SetCellNAtoms(int cellID, int natoms);
 
+    /**
+     * Set cell of an atom (cell membership itself is set with SetCellIndex)
+     * @param idx Index of atom
+     * @param cellID Index of cell container
+     * @return Standard error code
+     */
+      bool SetAtomCell(int idx, int cellID);
+
+    /**
+     * Move an atom from its current cell to another one, keeping the
+     * cell lists consistent without re-binning all atoms
+     * @param idx Index of atom
+     * @param cellID Index of the new cell container
+     * @return Standard error code
+     */
+      bool MoveAtomCell(int idx, int cellID);
+
+    /**
+     * Hand over the new cell of every atom for the next cell lists. They are
+     * built by BuildNextCells() while the current ones stay in use, and
+     * take over with SwapCells(); pruning the current cell pairs drops them.
+     * @param cell Cell of each atom
+     * @param pos Positions (wrapped, planar) to prune the cell pairs with
+     * @param rlist Pair list cutoff: cutoff plus skin
+     * @return Standard error code
+     */
+      bool SetNextCells(const int *cell, const double *pos, double rlist);
+
+    /**
+     * Build the next cell lists: cell contents, active cell pairs and full
+     * neighbor cell list, without touching the current ones
+     * @return Standard error code
+     */
+      bool BuildNextCells();
+
+    /**
+     * Replace the cell lists by the next ones (built first, if that has not
+     * happened yet)
+     * @return Standard error code
+     */
+      bool SwapCells();
+
+    /**
+     * Whether next cell lists have been handed over and not swapped in yet
+     */
+      inline bool NextCellsPending() { return this->m_nextpending; };
+
+    /**
+     * Whether building the next cell lists failed (they cannot be swapped in)
+     */
+      inline bool NextCellsFailed() { return this->m_nextfailed; };
+
+    /**
+     * Drop next cell lists that have been handed over, the current ones stay
+     */
+      void DropNextCells();
+
+
+    /**
+     * Set number of ghost cells, appended to the cells of the box
+     * (reserve memory: cells)
+     * @param nghostcells Number of ghost cells
+     * @return Standard error code
+     */
+      bool SetNGhostCells(int nghostcells);
+
+    /**
+     * Set number of ghost atoms (reserve memory: owners, shifts, padded
+     * position and force arrays)
+     * @param nghosts Number of ghost atoms
+     * @return Standard error code
+     */
+      bool SetNGhosts(int nghosts);
+
+    /**
+     * Set ghost atom: periodic copy of an atom, shifted by a box vector
+     * @param idx Index of ghost atom
+     * @param owner Index of the atom it is a copy of
+     * @param sx,sy,sz Shift vector
+     * @return Standard error code
+     */
+      bool SetGhost(int idx, int owner, double sx, double sy, double sz);
+
+    /**
+     * Set number of pairs of the ghost layout (reserve memory: ghost pairlist)
+     * @param npairs Number of pairs
+     * @return Standard error code
+     */
+      bool SetNGhostPairs(int npairs);
+
+    /**
+     * Set item in ghost pair list container
+     * @param idx Container index
+     * @param pair Pair index (cell or ghost cell)
+     * @return Standard error code
+     */
+      bool SetGhostPairItem(int idx, int pair);
+
+    /**
+     * Set cluster pair list to be used by the force kernel (NULL for the
+     * cell pair kernel); owned by the caller
+     */
+    inline void SetClusters(ClusterList *clusters) { this->m_clusters = clusters; };
+
 
     /* ################################################################################################# */
 
@@ -158,6 +323,12 @@ class Atoms {
      */
     inline double GetPotEnergy() { return m_potenergy; };
 
+    /**
+     * Get virial
+     * @return virial of atoms
+     */
+    inline double GetVirial() { return m_virial; };
+
     /**
      * Get position of atoms by index
      * @param idx Index of atom
@@ -197,12 +368,65 @@ class Atoms {
      */
     inline double* GetForce() { return this->m_force; };
 
+    /**
+     * Get periodic image counters (planar like positions)
+     * @return Image array of atoms
+     */
+    inline int* GetImage() { return this->m_image; };
+
+    /**
+     * Get position of atoms by index, undoing the wrapping into the box
+     * @param idx Index of atom
+     * @return pos Unwrapped position of atom
+     */
+    inline double GetUnwrappedPosition(int idx) { return this->GetPosition(idx) + this->GetImageOffset(idx); };
+
+    /**
+     * Get shift of a coordinate by the wrapping into the box
+     * @param idx Index of coordinate (planar like positions)
+     * @return Box vector component added by the image counters
+     */
+    double GetImageOffset(int idx);
+
+    /**
+     * Wrap the position of one atom into the box, counting the shift in its image counters
+     * @param i Index of atom
+     */
+    void WrapPosition(int i);
+
+    /**
+     * Get the position of one atom wrapped into the box, leaving it unchanged
+     * @param i Index of atom
+     * @param r Wrapped position
+     * @param s Box vectors (a, b, c) the atom is shifted back by
+     */
+    void GetWrappedPosition(int i, double *r, int *s);
+
+    /**
+     * Shift the position of one atom back by whole box vectors, as found by
+     * GetWrappedPosition, counting the shift in its image counters
+     * @param i Index of atom
+     * @param s Box vectors (a, b, c)
+     */
+    void ShiftPosition(int i, const int *s);
+
+    /**
+     * Reset periodic image counters, e.g. after new positions were read
+     */
+    void ClearImages();
+
     /**
      * Get temperature
      * @return temperature
      */
     inline double GetTemp() { return this->m_temperature; };
 
+    /**
+     * Get pressure
+     * @return pressure
+     */
+    inline double GetPressure() { return this->m_pressure; };
+
     /**
      * Get radial cutoff value
      * @return radcut cutoff
@@ -210,10 +434,79 @@ class Atoms {
     inline double GetRadCut() { return this->m_radcut; };
 
     /**
-     * Get box size
-     * @return box size
+     * Get box length
+     * @param dim Dimension (0: x, 1: y, 2: z)
+     * @return box length
+     */
+    inline double GetBoxSize(int dim) { return this->m_box[dim]; };
+
+    /**
+     * Get box tilt factor
+     * @param idx Tilt (0: xy, 1: xz, 2: yz)
+     * @return tilt factor
+     */
+    inline double GetBoxTilt(int idx) { return this->m_tilt[idx]; };
+
+    /**
+     * Get whether the box is triclinic
+     */
+    inline bool IsTriclinic() { return this->m_triclinic; };
+
+    /**
+     * Get box volume
+     */
+    inline double GetVolume() { return this->m_box[0]*this->m_box[1]*this->m_box[2]; };
+
+    /**
+     * Get distance between opposite faces of the box
+     * @param dim Dimension (0: faces spanned by b and c, 1: a and c, 2: a and b)
+     * @return box width
+     */
+     double GetBoxWidth(int dim);
+
+    /**
+     * Fractional coordinates of a position, -0.5..0.5 inside the box
+     * @param x,y,z Position
+     * @param s Fractional coordinates
      */
-    inline double GetBoxSize() { return this->m_boxsize; };
+    inline void ToFractional(double x, double y, double z, double *s)
+    {
+        s[2] = z * this->m_boxinv[2];
+        s[1] = (y - this->m_tilt[2]*s[2]) * this->m_boxinv[1];
+        s[0] = (x - this->m_tilt[0]*s[1] - this->m_tilt[1]*s[2]) * this->m_boxinv[0];
+    };
+
+    /**
+     * Position of fractional coordinates
+     * @param s Fractional coordinates
+     * @param r Position
+     */
+    inline void FromFractional(const double *s, double *r)
+    {
+        r[0] = this->m_box[0]*s[0] + this->m_tilt[0]*s[1] + this->m_tilt[1]*s[2];
+        r[1] = this->m_box[1]*s[1] + this->m_tilt[2]*s[2];
+        r[2] = this->m_box[2]*s[2];
+    };
+
+    /**
+     * Apply minimum image convention to a distance vector (branch-free)
+     * @param d Distance vector, modified in place
+     */
+    inline void MinImage(double *d)
+    {
+        if (!this->m_triclinic) {
+            d[0] -= this->m_box[0]*rint(d[0]*this->m_boxinv[0]);
+            d[1] -= this->m_box[1]*rint(d[1]*this->m_boxinv[1]);
+            d[2] -= this->m_box[2]*rint(d[2]*this->m_boxinv[2]);
+        } else {
+            double s[3];
+            this->ToFractional(d[0], d[1], d[2], s);
+            s[0] -= rint(s[0]);
+            s[1] -= rint(s[1]);
+            s[2] -= rint(s[2]);
+            this->FromFractional(s, d);
+        }
+    };
 
     /**
      * Get number of pairs
@@ -222,11 +515,74 @@ class Atoms {
     inline int GetNPairs() { return this->m_npairs; };
 
     /**
-     * Get item in pair list container
-     * @param idx Container index
-     * @return Pair item index
+     * Get first pair of each cell: the pairs of cell i are
+     * first[i]..first[i+1]-1 (ncells+1 entries)
+     */
+    inline const int* GetPairFirst() { return &this->m_pairfirst[0]; };
+
+    /**
+     * Get number of active pairs (none until they are pruned)
+     */
+    inline int GetNActivePairs() { return this->m_activepairs.size(); };
+
+    /**
+     * Get active pairs: indices of pairs, grouped by first cell in
+     * traversal order
+     */
+    inline const int* GetActivePairs() { return this->m_activepairs.empty() ? NULL : &this->m_activepairs[0]; };
+
+    /**
+     * Get first active pair of each cell in traversal order: the active
+     * pairs of cell order[k] are first[k]..first[k+1]-1 (ncells+1 entries)
+     */
+    inline const int* GetActiveFirst() { return &this->m_activefirst[0]; };
+
+    /**
+     * Get traversal order of the cells
+     */
+    inline const int* GetCellOrder() { return &this->m_cellorder[0]; };
+
+    /**
+     * Get second cell of a pair
+     * @param idx Index of pair
+     */
+    inline int GetPairCell(int idx) { return this->m_pairpack[idx] >> cellpair_imagebits; };
+
+    /**
+     * Get image code of the periodic shift of a pair
+     * @param idx Index of pair
+     */
+    inline int GetPairImage(int idx) { return this->m_pairpack[idx] & ((1 << cellpair_imagebits) - 1); };
+
+    /**
+     * Get periodic shift vector of a pair
+     * @param idx Index of pair
+     */
+    inline const double* GetPairShift(int idx) { return this->GetImageShift(this->GetPairImage(idx)); };
+
+    /**
+     * Get shift vector of an image code
+     * @param code Image code
      */
-     int GetPairItem(int idx);
+    inline const double* GetImageShift(int code) { return this->m_imageshift + 3*code; };
+
+    /**
+     * Get first entry of each cell in the full neighbor cell list (ncells+1)
+     */
+    inline const int* GetCellNbrFirst() { return &this->m_nbrfirst[0]; };
+
+    /**
+     * Get packed entries of the full neighbor cell list: neighbor cell and
+     * image code of the shift subtracted from the atoms of the cell itself
+     */
+    inline const unsigned int* GetCellNbr() { return &this->m_nbrpack[0]; };
+
+    /**
+     * Print the memory used by atoms, cell lists, pair lists and the ghost
+     * and cluster layouts, with the size of unpacked pair lists for comparison
+     * @param fp Open output file
+     */
+     void PrintMemory(FILE *fp);
 
     /**
      * Get number of cells
@@ -263,6 +619,66 @@ class Atoms {
      */
      int GetCellNAtoms(int cellID);
 
+    /**
+     * Get cell of an atom
+     * @param idx Index of atom
+     * @return Index of cell container
+     */
+     int GetAtomCell(int idx);
+
+    /**
+     * Get whether forces are computed on the ghost layout
+     */
+    inline bool UseGhosts() { return this->m_useghosts; };
+
+    /**
+     * Get number of ghost cells
+     */
+    inline int GetNGhostCells() { return this->m_nghostcells; };
+
+    /**
+     * Get number of ghost atoms
+     */
+    inline int GetNGhosts() { return this->m_nghosts; };
+
+    /**
+     * Get owners of the ghost atoms
+     */
+    inline int* GetGhostOwner() { return this->m_ghostowner; };
+
+    /**
+     * Get shift vectors of the ghost atoms (3 per ghost)
+     */
+    inline double* GetGhostShift() { return this->m_ghostshift; };
+
+    /**
+     * Get padded positions: atoms followed by ghost atoms (planar,
+     * natoms+nghosts per coordinate)
+     */
+    inline double* GetPadPosition() { return this->m_padpos; };
+
+    /**
+     * Get padded force array (one copy per thread)
+     */
+    inline double* GetPadForce() { return this->m_padforce; };
+
+    /**
+     * Get number of pairs of the ghost layout
+     */
+    inline int GetNGhostPairs() { return this->m_nghostpairs; };
+
+    /**
+     * Get item in ghost pair list container
+     * @param idx Container index
+     * @return Pair item index
+     */
+     int GetGhostPairItem(int idx);
+
+    /**
+     * Get cluster pair list of the force kernel (NULL if not used)
+     */
+    inline ClusterList* GetClusters() { return this->m_clusters; };
+
     private:
         /**
          * Init flag
@@ -289,6 +705,11 @@ class Atoms {
          */
         double m_potenergy;
 
+        /**
+         * Virial of system
+         */
+        double m_virial;
+
         /**
          * Initial position of each atom
          */
@@ -304,10 +725,21 @@ class Atoms {
          */
         double* m_force;
 
+        /**
+         * Number of box lengths each coordinate was shifted by when
+         * wrapping positions into the box
+         */
+        int* m_image;
+
         /**
          * Temperature in system
          */
         double m_temperature;
+
+        /**
+         * Pressure in system
+         */
+        double m_pressure;
         
         /**
          * R-boundary max. cut
@@ -315,9 +747,12 @@ class Atoms {
         double m_radcut;
         
         /**
-         * The box size
+         * The box: lengths, their inverse and tilt factors (xy, xz, yz)
          */
-        double m_boxsize;
+        double m_box[3];
+        double m_boxinv[3];
+        double m_tilt[3];
+        bool m_triclinic;
         
         /**
          * Number of pairs
@@ -325,15 +760,42 @@ class Atoms {
         int m_npairs;
 
         /**
-         * Pair list container
+         * Pair list container: first pair of each cell, and per pair the
+         * second cell and image code packed in 32 bits
+         */
+        std::vector<int> m_pairfirst;
+        std::vector<unsigned int> m_pairpack;
+
+        /**
+         * Active pairs left after pruning with the first one of each cell in
+         * traversal order, bounding box of the atoms of each cell: lower and
+         * upper corner
+         */
+        std::vector<int> m_activepairs;
+        std::vector<int> m_activefirst;
+        std::vector<double> m_cellbox;
+
+        /**
+         * Shift vector of each image code
+         */
+        double m_imageshift[3*cellpair_nimages];
+
+        /**
+         * Full neighbor cell list: first entry per cell, packed entries
          */
-        int* m_pairlist;
+        std::vector<int> m_nbrfirst;
+        std::vector<unsigned int> m_nbrpack;
 
         /**
          * Number of cells
          */
         int m_ncells;
 
+        /**
+         * Traversal order of the cells
+         */
+        std::vector<int> m_cellorder;
+
 	/**
 	 * Cell list data: natoms
          */
@@ -344,6 +806,76 @@ class Atoms {
          */
         std::vector<std::vector<int> > m_cells;
 
+        /**
+         * Cell list data: cell of each atom
+         */
+        int* m_atomcell;
+
+        /**
+         * Next cell lists (natoms per cell, idxlist, cell of each atom,
+         * active pairs and full neighbor list), the cells and positions
+         * they are built from and their state
+         */
+        std::vector<int> m_nextnatoms;
+        std::vector<std::vector<int> > m_nextcells;
+        std::vector<int> m_nextatomcell;
+        std::vector<int> m_nextactivepairs;
+        std::vector<int> m_nextactivefirst;
+        std::vector<int> m_nextnbrfirst;
+        std::vector<unsigned int> m_nextnbrpack;
+        const int *m_nextcell;
+        const double *m_nextpos;
+        double m_nextrlist;
+        bool m_nextpending;
+        bool m_nextbuilt;
+        bool m_nextfailed;
+
+        /**
+         * Ghost layout: flag, number of ghost cells and ghost atoms
+         */
+        bool m_useghosts;
+        int m_nghostcells;
+        int m_nghosts;
+        int m_maxghosts;
+
+        /**
+         * Ghost layout: owner and shift of each ghost atom
+         */
+        int* m_ghostowner;
+        double* m_ghostshift;
+
+        /**
+         * Ghost layout: padded positions and forces
+         */
+        double* m_padpos;
+        double* m_padforce;
+
+        /**
+         * Ghost layout: pair list container (no shifts)
+         */
+        int m_nghostpairs;
+        int* m_ghostpairlist;
+
+        /**
+         * Cluster pair list, if used instead of the cell pairs
+         */
+        ClusterList* m_clusters;
+
+        /**
+         * Prune the cell pairs for the given cell contents and positions
+         * into the given active pair lists (see PruneCellPairs)
+         */
+        void PruneCells(const std::vector<std::vector<int> > &cells, const int *natoms_in_cell,
+                        const double *pos, double rlist,
+                        std::vector<int> &activepairs, std::vector<int> &activefirst);
+
+        /**
+         * Build the full neighbor cell list of the given active pairs
+         * (see BuildCellNeighbors)
+         */
+        void BuildNeighbors(const std::vector<int> &activepairs, const std::vector<int> &activefirst,
+                            std::vector<int> &nbrfirst, std::vector<unsigned int> &nbrpack);
+
 };
 
 #endif //> !class
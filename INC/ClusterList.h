@@ -0,0 +1,148 @@
+/**
+ * ClusterList class
+ *
+ * @short This class groups the atoms of each cell into clusters of a fixed size and lists the pairs of clusters whose bounding boxes are within the cutoff plus skin, so the force kernel can compute all interactions of a cluster pair at once with masked cutoffs instead of looping over irregular neighbor counts.
+ */
+
+#ifndef MD_CLUSTERLIST_H
+#define MD_CLUSTERLIST_H
+
+//Includes
+#include <math.h>
+#include <vector>
+#include "Atoms.h"
+
+const int cluster_size=4;             /* atoms per cluster (slots, padded) */
+
+/**
+ * All cluster pairs of one i-cluster with the same periodic shift:
+ * the j-clusters are jlist[jbeg..jend)
+ */
+struct ClusterEntry {
+    int ci, jbeg, jend;
+    double shift[3];
+};
+
+class ClusterList {
+
+    public:
+    /**
+     * Default constructor
+     */
+    ClusterList();
+
+    /**
+     * Default destructor
+     */
+    virtual ~ClusterList();
+
+    /**
+     * Build clusters from the cell lists and the cluster pair list from the
+     * cell pair list. Atoms have to be sorted into their cells.
+     * @param Pointer to atom class
+     * @param rlist Pair list cutoff: cutoff plus skin
+     * @return Standard error code
+     */
+     bool Build(Atoms *atom, double rlist);
+
+    /* ################################################################################ */
+
+    /**
+     * Get number of clusters
+     */
+     inline int GetNClusters() { return this->m_nclusters; };
+
+    /**
+     * Get number of slots (clusters times cluster size)
+     */
+     inline int GetNSlots() { return this->m_nclusters * cluster_size; };
+
+    /**
+     * Get atom of each slot (-1 for padding)
+     */
+     inline const int* GetSlotAtom() { return &this->m_slotatom[0]; };
+
+    /**
+     * Get slot of each atom
+     */
+     inline const int* GetAtomSlot() { return &this->m_atomslot[0]; };
+
+    /**
+     * Get number of atoms (filled slots) of each cluster
+     */
+     inline const int* GetClusterNAtoms() { return &this->m_natoms[0]; };
+
+    /**
+     * Get number of i-cluster entries
+     */
+     inline int GetNEntries() { return this->m_entries.size(); };
+
+    /**
+     * Get i-cluster entries
+     */
+     inline const ClusterEntry* GetEntries() { return &this->m_entries[0]; };
+
+    /**
+     * Get j-clusters of all entries
+     */
+     inline const int* GetJList() { return &this->m_jlist[0]; };
+
+    /**
+     * Get number of cluster pairs
+     */
+     inline int GetNPairs() { return this->m_jlist.size(); };
+
+    /**
+     * Get positions in slot order (planar, nslots per coordinate)
+     */
+     inline double* GetPosition() { return &this->m_pos[0]; };
+
+    /**
+     * Get forces in slot order (one copy per thread)
+     */
+     inline double* GetForce() { return &this->m_force[0]; };
+
+    /**
+     * Get memory held by the clusters and the cluster pair list in bytes
+     */
+     double GetMemory();
+
+    /**
+     * Get number of builds
+     */
+     inline int GetNBuild() { return this->m_nbuild; };
+
+    private:
+        /**
+         * Number of clusters and builds
+         */
+        int m_nclusters;
+        int m_nbuild;
+
+        /**
+         * Atom of each slot, slot of each atom and atoms per cluster
+         */
+        std::vector<int> m_slotatom;
+        std::vector<int> m_atomslot;
+        std::vector<int> m_natoms;
+
+        /**
+         * Bounding box of each cluster: lower and upper corner
+         */
+        std::vector<double> m_bbox;
+
+        /**
+         * Cluster pair list: entries per i-cluster and shift, j-clusters
+         */
+        std::vector<ClusterEntry> m_entries;
+        std::vector<int> m_jlist;
+
+        /**
+         * Positions and per-thread forces in slot order
+         */
+        std::vector<double> m_pos;
+        std::vector<double> m_force;
+
+};
+
+#endif //> !class
@@ -0,0 +1,139 @@
+/**
+ * Correlator class
+ *
+ * @short This class provides a multiple-tau correlator (Ramirez, Sinha and Lee, J. Chem. Phys. 133, 154103 (2010)) for the mean-squared displacement of the unwrapped positions or the velocity autocorrelation. Each level keeps a short history of samples averaged over m^level steps, so memory grows with the logarithm of the longest lag only.
+ */
+
+#ifndef MD_CORRELATOR_H
+#define MD_CORRELATOR_H
+
+//Includes
+#include <math.h>
+#include <vector>
+#include "Atoms.h"
+
+class Correlator {
+
+    public:
+    /**
+     * Quantity to correlate
+     */
+    enum Kind { MSD, VACF };
+
+    /**
+     * Default constructor
+     */
+    Correlator();
+
+    /**
+     * Default destructor
+     */
+    virtual ~Correlator();
+
+    /**
+     * Init
+     * @param Pointer to atom class
+     * @param kind MSD of the unwrapped positions or VACF
+     * @param nlevels Number of levels; the longest lag is about p*m^(nlevels-1) samples
+     * @return Standard error code
+     */
+     bool Init(Atoms *atom, Kind kind, int nlevels);
+
+    /**
+     * Add the current positions or velocities of the atoms as next sample
+     * @return Standard error code
+     */
+     bool Sample();
+
+    /**
+     * Clear the history and all accumulated correlations
+     */
+     void Reset();
+
+    /* ################################################################################ */
+
+    /**
+     * Get number of lags (levels times lags per level, including lags without data)
+     */
+     int GetNLags() { return this->m_sum.size(); };
+
+    /**
+     * Get lag in units of samples
+     * @param k Index of lag
+     */
+     long GetLag(int k);
+
+    /**
+     * Get correlation at a lag, averaged over time origins and atoms
+     * @param k Index of lag
+     */
+     double GetValue(int k);
+
+    /**
+     * Get number of time origins accumulated at a lag
+     * @param k Index of lag
+     */
+     long GetCount(int k) { return this->m_count[k]; };
+
+    /**
+     * Get number of samples
+     */
+     long GetNSamples() { return this->m_nsamples; };
+
+    private:
+        /**
+         * Insert a sample into a level, correlate it with the history of
+         * the level and pass block averages on to the next level
+         * @param level Level
+         * @param v Sample (3*natoms values, planar like positions)
+         */
+         void Push(int level, const double *v);
+
+        /**
+         * Pointer to atoms
+         */
+        Atoms *m_atom;
+
+        /**
+         * Quantity to correlate
+         */
+        Kind m_kind;
+
+        /**
+         * Number of values per sample and number of levels
+         */
+        int m_nvalues;
+        int m_nlevels;
+
+        /**
+         * Number of samples
+         */
+        long m_nsamples;
+
+        /**
+         * History of each level: p samples in a ring, its newest entry and fill
+         */
+        std::vector<std::vector<double> > m_hist;
+        std::vector<int> m_head;
+        std::vector<int> m_nhist;
+
+        /**
+         * Block average passed on to the next level and number of samples in it
+         */
+        std::vector<std::vector<double> > m_acc;
+        std::vector<int> m_nacc;
+
+        /**
+         * Accumulated correlation and number of time origins per level and lag
+         */
+        std::vector<double> m_sum;
+        std::vector<long> m_count;
+
+        /**
+         * Unwrapped positions of the current sample
+         */
+        std::vector<double> m_unwrapped;
+
+};
+
+#endif //> !class
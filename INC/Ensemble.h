@@ -0,0 +1,74 @@
+/**
+ * Ensemble class
+ *
+ * @short This class runs many independent MD replicas in one process, scheduling whole replicas across threads
+ */
+
+#ifndef MD_ENSEMBLE_H
+#define MD_ENSEMBLE_H
+
+//Includes
+#include <stdio.h>
+#include <vector>
+#include "MyMD.h"
+
+class Ensemble {
+
+    public:
+    /**
+     * Default constructor
+     */
+    Ensemble();
+
+    /**
+     * Default destructor
+     */
+    virtual ~Ensemble();
+
+    /**
+     * Read a list of input decks, one file name per line, and create one replica per deck
+     * @param fp Pointer to list file
+     * @return Standard error code
+     */
+     bool ReadList(FILE *fp);
+
+    /**
+     * Add a replica with the given parameters
+     * @param params Simulation parameters of the replica
+     * @return Standard error code
+     */
+     bool AddReplica(const MDParams &params);
+
+    /**
+     * Read restarts, open per replica output files and compute initial forces
+     * @return Standard error code
+     */
+     virtual bool Setup();
+
+    /**
+     * Run all replicas for their number of MD steps
+     * @return Standard error code
+     */
+     virtual bool Run();
+
+    /* ################################################################################ */
+
+    /**
+     * Get number of replicas
+     */
+     int GetNReplicas() { return this->m_replicas.size(); };
+
+    /**
+     * Get replica by index
+     */
+     MyMD* GetReplica(int idx) { return this->m_replicas[idx]; };
+
+    protected:
+        /**
+         * Replicas (each owns its atoms, force and integrator)
+         */
+        std::vector<MyMD*> m_replicas;
+
+};
+
+#endif //> !class
@@ -40,6 +40,20 @@
     */
    void ComputeForce(Atoms *atom);
 
+   /**
+    * Force computation shared by a thread team that runs the MD step
+    * @param tid Thread number in the team
+    * @param nthreads Size of the team
+    */
+   void ComputeForce(Atoms *atom, int tid, int nthreads);
+
+   /**
+    * Energy of one atom at a trial position with the atoms in the given cells
+    * @return Energy
+    */
+   double ComputeAtomEnergy(Atoms *atom, int idx, double x, double y, double z,
+                            const std::vector<int> &cells);
+
    /**
     * Calculate different kinds of pair-potentials
     * @return a pointer to an object of class Pair
@@ -8,6 +8,8 @@
 #ifndef MD_HELPER_H
 #define MD_HELPER_H
 
+#include <math.h>
+
 /* generic file- or pathname buffer length */
 #define BLEN 200
 
@@ -30,14 +32,37 @@ extern "C" int get_a_line(FILE *fp, char *buf);
 void azzero(double *d, const int n);
 
 /**
- * Apply minimum image convention
+ * Barrier of a thread team that shares the work of an MD step. Without a
+ * team (a single thread) it does nothing, so the same code runs either way.
+ * @param nthreads Size of the team
+ * @return void
+ */
+inline void team_barrier(int nthreads)
+{
+#if defined(_OPENMP)
+    if (nthreads > 1) {
+#pragma omp barrier
+    }
+#endif
+}
+
+/**
+ * Wall clock time, also without OpenMP
+ * @return Seconds since the epoch
+ */
+double wallclock();
+
+/**
+ * Apply minimum image convention (branch-free, inlined into the force kernels)
  * @param Double value
  * @param double matrix of box X 2
  * @param double value of box
  * @return The modified double which was given as the first parameter
  */
-//__attribute__((always_inline,pure))
-double pbc(double x, const double boxby2, const double box);
+inline double pbc(double x, const double boxby2, const double box)
+{
+    return x - box*rint(x/box);
+}
 
 #endif //> !class
 
@@ -12,6 +12,75 @@
 #include <math.h>
 #include "Atoms.h"
 #include "Force.h"
+#include "ClusterList.h"
+
+/**
+ * Cell grid and cell pair topology of the last full cell list build,
+ * with the parameters they were built for. Positions do not enter,
+ * so the topology stays valid until the box, cutoff or cell ratio change.
+ */
+struct CellTopology {
+    /**
+     * Parameters the topology was built for
+     */
+    double box[3], tilt[3], rcut, cellrat;
+    bool ghost, valid;
+
+    /**
+     * Grid layout, cell lengths (box size / ngrid) and size of items in
+     * cell container
+     */
+    int ngrid[3];
+    double delta[3];
+    int nidx;
+
+    /**
+     * Margin added to the cutoff when building the cell pair list:
+     * atoms may leave their cell by half of it before they are migrated
+     */
+    double skin;
+
+    /**
+     * Number of full builds
+     */
+    int nbuild;
+
+    CellTopology() : rcut(0), cellrat(0), ghost(false), valid(false), nidx(0), skin(0), nbuild(0)
+    {
+        for (int d=0; d < 3; ++d) {
+            box[d] = tilt[d] = delta[d] = 0;
+            ngrid[d] = 0;
+        }
+    };
+
+    /**
+     * Check whether the topology was built for the current parameters
+     */
+    inline bool Matches(Atoms *atom, double _cellrat, bool _ghost)
+    {
+        if (!valid || rcut != atom->GetRadCut() || cellrat != _cellrat || ghost != _ghost) return false;
+        for (int d=0; d < 3; ++d) {
+            if (box[d] != atom->GetBoxSize(d) || tilt[d] != atom->GetBoxTilt(d)) return false;
+        }
+        return true;
+    };
+
+    /**
+     * Record the parameters of a new build
+     */
+    inline void SetKey(Atoms *atom, double _cellrat, bool _ghost)
+    {
+        for (int d=0; d < 3; ++d) {
+            box[d] = atom->GetBoxSize(d);
+            tilt[d] = atom->GetBoxTilt(d);
+        }
+        rcut = atom->GetRadCut();
+        cellrat = _cellrat;
+        ghost = _ghost;
+        valid = true;
+        ++nbuild;
+    };
+};
 
 class Integrator {
 
@@ -35,42 +104,108 @@ class Integrator {
      bool Init(Atoms *atom, Force *force);
 
     /**
-     * Calculate Kinetic Energy
+     * Calculate Kinetic Energy, temperature and pressure (virial from the last force computation)
      * @return Standard error code
     */
       bool CalcKinEnergy();
+    /**
+     * Share of one thread of a team in the kinetic energy: the partial sums
+     * of the threads are added up by the first one in a fixed order
+     * @param tid Thread number in the team
+     * @param nthreads Size of the team
+     * @return Standard error code
+    */
+      bool CalcKinEnergy(int tid, int nthreads);
 
     /**
      * Calculate Velocity
      * @return Standard error code
     */
       bool CalcVelocity();
+    /**
+     * Share of one thread of a team in the velocity verlet step: each thread
+     * propagates a contiguous chunk of the coordinates, cell updates and
+     * forces are shared by the team
+     * @param tid Thread number in the team
+     * @param nthreads Size of the team
+     * @return Standard error code
+    */
+      bool CalcVelocity(int tid, int nthreads);
 
     /**
-     * Update cells
+     * Update cells: set up the grid and cell pair list, sort all atoms into cells
      * @return Standard error code
     */
       bool UpdateCells();
 
+    /**
+     * Move atoms that crossed a cell boundary to their new cell, once the
+     * largest displacement since the last check exceeds half the skin
+     * @return Standard error code
+    */
+      bool MigrateAtoms();
+    /**
+     * Share of one thread of a team in the migration: displacements, wrapping
+     * and new cells per chunk of atoms, the cell lists are updated by the
+     * first thread. A team of several threads sets up the next cell lists
+     * one step ahead, to be built during the force computation and swapped
+     * in at the next call.
+     * @param tid Thread number in the team
+     * @param nthreads Size of the team
+     * @return Standard error code
+    */
+      bool MigrateAtoms(int tid, int nthreads);
+
+    /**
+     * Build ghost cells and the ghost pair list from the periodic cell pairs
+     * @return Standard error code
+    */
+      bool BuildGhostLayout();
+
+    /**
+     * Fill ghost cells with shifted copies of the atoms of their source cells
+     * @return Standard error code
+    */
+      bool UpdateGhosts();
+
+    /**
+     * Build clusters and the cluster pair list from the current cell lists
+     * @return Standard error code
+    */
+      bool BuildClusters();
+
+    /**
+     * Wrap positions into the box, counting the shifts in the image counters of the atoms
+     * @return Standard error code
+    */
+      bool WrapPositions();
+
+    /**
+     * Cell of a position (wrapped into the box) on the current grid
+     * @param x,y,z Position
+     * @return Index of cell container
+     */
+      int CellIndex(double x, double y, double z);
+
     /**
      * Set time step
      */
     inline void SetTimestep(double timestep) { this->m_timestep = timestep; };
 
     /**
-     * Set grid layout
+     * Set size of items in cell container
      */
-    inline void SetNGrid(int ngrid) { this->m_ngrid = ngrid; };
+    inline void SetNIdx(int nidx) { this->m_topo.nidx = nidx; };
 
     /**
-     * Set size of items in cell container
+     * Use a ghost layer instead of periodic shifts in the force kernel
      */
-    inline void SetNIdx(int nidx) { this->m_nidx = nidx; };
+    inline void SetGhost(bool ghost) { this->m_ghost = ghost; };
 
     /**
-     * Set Delta
+     * Use the cluster pair kernel instead of the cell pair kernel
      */
-    inline void SetDelta(double delta) { this->m_delta = delta; };
+    inline void SetCluster(bool cluster) { this->m_cluster = cluster; };
 
     /* ################################################################################ */
 
@@ -80,30 +215,49 @@ class Integrator {
      double GetTimestep() { return this->m_timestep; };
 
     /**
-     * Get grid layout
+     * Get grid layout: number of cells along box vector dim
      */
-     int GetNGrid() { return this->m_ngrid; };
+     int GetNGrid(int dim) { return this->m_topo.ngrid[dim]; };
 
     /**
      * Get size of items in cell container
      */
-     int GetNIdx() { return this->m_nidx; };
+     int GetNIdx() { return this->m_topo.nidx; };
 
     /**
-     * Get Delta
+     * Get Delta: box length / ngrid along dim
      */
-     double GetDelta() { return this->m_delta; };
-    
-    /** 
-     * Helper function: apply minimum image convention
-     * @return convention
+     double GetDelta(int dim) { return this->m_topo.delta[dim]; };
+
+    /**
+     * Get margin added to the cutoff when building the cell pair list
      */
-    inline double pbc(double x,  double boxby2,  double box)
-    {
-        while (x >  boxby2) x -= box;
-        while (x < -boxby2) x += box;
-        return x;
-    };
+     double GetSkin() { return this->m_topo.skin; };
+
+    /**
+     * Get whether a ghost layer is used
+     */
+     bool GetGhost() { return this->m_ghost; };
+
+    /**
+     * Get whether the cluster pair kernel is used
+     */
+     bool GetCluster() { return this->m_cluster; };
+
+    /**
+     * Get number of full builds of the cell grid and pair list
+     */
+     int GetNBuild() { return this->m_topo.nbuild; };
+
+    /**
+     * Force a full rebuild of the cell grid and pair list at the next UpdateCells
+     */
+     void InvalidateCells() { this->m_topo.valid = false; };
+
+    /**
+     * Get number of cell list updates by migration
+     */
+     int GetNMigrate() { return this->m_nmigrate; };
 
     private:
         /**
@@ -123,19 +277,49 @@ class Integrator {
         double m_timestep;
         
         /**
-         * Grid layout
+         * Cell grid and cell pair topology
+         */
+        CellTopology m_topo;
+
+        /**
+         * Positions at last cell list update, and the ones the next cell
+         * lists are built from
+         */
+        double *m_xref;
+        double *m_xnext;
+
+        /**
+         * Number of cell list updates by migration
+         */
+        int m_nmigrate;
+
+        /**
+         * Partial results of the threads of a team (kinetic energy, largest
+         * displacement), the cell of each atom when migrating, and the box
+         * vectors it is wrapped by
+         */
+        std::vector<double> m_part;
+        std::vector<int> m_newcell;
+        std::vector<int> m_wrap;
+
+        /**
+         * Largest displacement at the last step, kept by every thread of a
+         * team to extrapolate the next one
          */
-        int m_ngrid;
+        std::vector<double> m_dlast;
 
         /**
-         * Size of items in cell container
+         * Ghost layer: flag, source cell and shift vector of each ghost cell
          */
-        int m_nidx;
+        bool m_ghost;
+        std::vector<int> m_ghostsrc;
+        std::vector<double> m_ghostshift;
 
         /**
-         * Ratio: Box size / ngrid
+         * Cluster pair kernel: flag and cluster pair list
          */
-        double m_delta; 
+        bool m_cluster;
+        ClusterList *m_clusters;
 
 };
 
@@ -0,0 +1,39 @@
+/**
+ * Layout policies
+ *
+ * @short These structs describe how per-atom vectors (positions, forces) are laid out in memory, so a force kernel can be instantiated for each of them: the x, y and z components of slot i are at Offset(i), Offset(i)+Stride(n) and Offset(i)+2*Stride(n) of an array of Size(n) values.
+ */
+
+#ifndef MD_LAYOUT_H
+#define MD_LAYOUT_H
+
+/**
+ * Planar (SoA): all x, then all y, then all z
+ */
+struct LayoutSoA {
+    static inline int Size(int n) { return 3*n; };
+    static inline int Offset(int i) { return i; };
+    static inline int Stride(int n) { return n; };
+};
+
+/**
+ * Packed (AoS): x, y, z of each slot next to each other, padded to four
+ * values so a slot never spans two cache lines
+ */
+struct LayoutAoS {
+    static inline int Size(int n) { return 4*n; };
+    static inline int Offset(int i) { return 4*i; };
+    static inline int Stride(int n) { return 1; };
+};
+
+/**
+ * Blocked (AoSoA): blocks of 8 slots, planar within the block
+ */
+struct LayoutAoSoA {
+    static const int block = 8;
+    static inline int Size(int n) { return 3*block*((n + block-1)/block); };
+    static inline int Offset(int i) { return 3*block*(i/block) + i%block; };
+    static inline int Stride(int n) { return block; };
+};
+
+#endif //> !class
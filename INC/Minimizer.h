@@ -0,0 +1,250 @@
+/**
+ * Minimizer class
+ *
+ * @short This class provides energy minimization (FIRE and Polak-Ribiere conjugate gradient) of the MD system, reusing the force and cell list machinery of the integrator.
+ */
+
+#ifndef MD_MINIMIZER_H
+#define MD_MINIMIZER_H
+
+//Includes
+#include <math.h>
+#include <string>
+#include "Atoms.h"
+#include "Force.h"
+#include "Integrator.h"
+
+class Minimizer {
+
+    public:
+    /**
+     * Minimization styles
+     */
+    enum Style { FIRE=0, CG=1 };
+
+    /**
+     * Default constructor
+     */
+    Minimizer();
+
+    /**
+     * Default destructor
+     */
+    virtual ~Minimizer();
+
+    /**
+     * Init
+     * @param Pointer to atom class
+     * @param Pointer to force class
+     * @param Pointer to integrator class (owns the cell list)
+     * @return Standard error code
+     */
+     bool Init(Atoms *atom, Force *force, Integrator *integrator);
+
+    /**
+     * Set minimization style by name ("fire" or "cg")
+     * @param style Name of the style
+     * @return Standard error code
+     */
+     bool SetStyle(std::string style);
+
+    /**
+     * Prepare a minimization run: compute initial forces and energy
+     * @return Standard error code
+     */
+     bool Setup();
+
+    /**
+     * Perform one minimizer iteration
+     * @return Standard error code
+     */
+     bool Iterate();
+
+    /**
+     * Set convergence threshold on the largest atomic force
+     */
+    inline void SetForceTol(double ftol) { this->m_ftol = ftol; };
+
+    /**
+     * Set convergence threshold on the relative energy change
+     */
+    inline void SetEnergyTol(double etol) { this->m_etol = etol; };
+
+    /**
+     * Set largest displacement of an atom per iteration
+     */
+    inline void SetMaxStep(double maxstep) { this->m_maxstep = maxstep; };
+
+    /**
+     * Set (initial) FIRE time step
+     */
+    inline void SetTimestep(double timestep) { this->m_timestep = timestep; };
+
+    /* ################################################################################ */
+
+    /**
+     * Get minimization style
+     */
+     int GetStyle() { return this->m_style; };
+
+    /**
+     * Get convergence flag
+     */
+     bool IsConverged() { return this->m_converged; };
+
+    /**
+     * Get stop flag (converged or line search failure)
+     */
+     bool IsStopped() { return this->m_stopped; };
+
+    /**
+     * Get reason for stopping
+     */
+     std::string GetStopReason() { return this->m_stopreason; };
+
+    /**
+     * Get largest atomic force of current configuration
+     */
+     double GetMaxForce() { return this->m_fmax; };
+
+    /**
+     * Get energy change of last iteration
+     */
+     double GetDeltaEnergy() { return this->m_epot - this->m_epotold; };
+
+    /**
+     * Get number of force evaluations
+     */
+     int GetNForceEval() { return this->m_nfeval; };
+
+    private:
+        /**
+         * One FIRE iteration
+         * @return Standard error code
+         */
+         bool IterateFIRE();
+
+        /**
+         * One Polak-Ribiere conjugate gradient iteration
+         * @return Standard error code
+         */
+         bool IterateCG();
+
+        /**
+         * Backtracking line search along the current search direction
+         * @return Step length (0 on failure)
+         */
+         double LineSearch();
+
+        /**
+         * Recompute forces and energy, migrating atoms between cells if needed
+         * @return Potential energy
+         */
+         double EvalForce();
+
+        /**
+         * Largest atomic force and sum of squared forces
+         * @param fsq Output: sum of squared force components
+         * @return Largest atomic force
+         */
+         double MaxForce(double *fsq);
+
+        /**
+         * Check convergence criteria after an iteration
+         */
+         void CheckConvergence();
+
+        /**
+         * Pointer to atoms
+         */
+        Atoms *m_atom;
+
+        /**
+         * Pointer to forces
+         */
+        Force *m_force;
+
+        /**
+         * Pointer to integrator (cell list updates)
+         */
+        Integrator *m_integrator;
+
+        /**
+         * Minimization style
+         */
+        int m_style;
+
+        /**
+         * Convergence threshold: largest atomic force
+         */
+        double m_ftol;
+
+        /**
+         * Convergence threshold: relative energy change
+         */
+        double m_etol;
+
+        /**
+         * Largest displacement of an atom per iteration
+         */
+        double m_maxstep;
+
+        /**
+         * FIRE initial time step
+         */
+        double m_timestep;
+
+        /**
+         * FIRE state: current time step, mixing parameter and number of downhill steps
+         */
+        double m_dt;
+        double m_alpha;
+        int m_npos;
+
+        /**
+         * Current and previous potential energy
+         */
+        double m_epot;
+        double m_epotold;
+
+        /**
+         * Largest atomic force and sum of squared forces
+         */
+        double m_fmax;
+        double m_fsq;
+
+        /**
+         * CG state: previous step length
+         */
+        double m_lsalpha;
+
+        /**
+         * Number of force evaluations
+         */
+        int m_nfeval;
+
+        /**
+         * Status flags
+         */
+        bool m_converged;
+        bool m_stopped;
+        std::string m_stopreason;
+
+        /**
+         * FIRE velocities (CG: search direction)
+         */
+        double *m_dir;
+
+        /**
+         * CG: forces of previous iteration
+         */
+        double *m_fold;
+
+        /**
+         * CG: positions at start of line search
+         */
+        double *m_xold;
+
+};
+
+#endif //> !class
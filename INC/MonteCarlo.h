@@ -0,0 +1,173 @@
+/**
+ * MonteCarlo class
+ *
+ * @short This class provides Metropolis Monte Carlo with single particle moves. The energy change of a move is computed from the cell of the atom and its neighbor cells only, reusing the cell list of the integrator; sweeps over a checkerboard of cells run in parallel.
+ */
+
+#ifndef MD_MONTECARLO_H
+#define MD_MONTECARLO_H
+
+//Includes
+#include <math.h>
+#include <vector>
+#include "Atoms.h"
+#include "Force.h"
+#include "Integrator.h"
+#include "Random.h"
+
+class MonteCarlo {
+
+    public:
+    /**
+     * Default constructor
+     */
+    MonteCarlo();
+
+    /**
+     * Default destructor
+     */
+    virtual ~MonteCarlo();
+
+    /**
+     * Init
+     * @param Pointer to atom class
+     * @param Pointer to force class
+     * @param Pointer to integrator class (owns the cell list)
+     * @return Standard error code
+     */
+     bool Init(Atoms *atom, Force *force, Integrator *integrator);
+
+    /**
+     * Prepare a Monte Carlo run: bin atoms, build the neighbor cells of each
+     * cell and the checkerboard coloring, compute the initial energy
+     * @return Standard error code
+     */
+     bool Setup();
+
+    /**
+     * Perform one sweep (one trial move per atom on average)
+     * @return Standard error code
+     */
+     bool Sweep();
+
+    /**
+     * Set temperature
+     */
+    inline void SetTemp(double temp) { this->m_temperature = temp; };
+
+    /**
+     * Set largest displacement per coordinate of a trial move
+     */
+    inline void SetMaxDisp(double maxdisp) { this->m_maxdisp = maxdisp; };
+
+    /**
+     * Set random seed
+     */
+    inline void SetSeed(unsigned long seed) { this->m_seed = seed; };
+
+    /* ################################################################################ */
+
+    /**
+     * Get temperature
+     */
+     double GetTemp() { return this->m_temperature; };
+
+    /**
+     * Get largest displacement per coordinate of a trial move
+     */
+     double GetMaxDisp() { return this->m_maxdisp; };
+
+    /**
+     * Get number of sweeps done since Setup
+     */
+     int GetNSweeps() { return this->m_nsweeps; };
+
+    /**
+     * Get fraction of accepted trial moves since Setup
+     */
+     double GetAcceptRatio() { return (this->m_ntrial > 0) ? (double)this->m_naccept/this->m_ntrial : 0.0; };
+
+    /**
+     * Get number of colors of the checkerboard (0 if sweeps run serially)
+     */
+     int GetNColors() { return this->m_colors.size(); };
+
+    private:
+        /**
+         * Sweep over randomly chosen atoms, one at a time
+         */
+         void SweepSerial();
+
+        /**
+         * Sweep over the cells of one color after the other, cells of
+         * the same color in parallel; moves stay within the cell
+         */
+         void SweepCheckerboard();
+
+        /**
+         * Attempt a random displacement of one atom
+         * @param random Random number generator of the calling thread
+         * @param idx Index of atom
+         * @param incell Reject moves that leave the cell of the atom
+         * @param de Energy change of an accepted move is added here
+         * @return True if the move was accepted
+         */
+         bool TrialMove(Random &random, int idx, bool incell, double *de);
+
+        /**
+         * Pointer to atoms
+         */
+        Atoms *m_atom;
+
+        /**
+         * Pointer to forces
+         */
+        Force *m_force;
+
+        /**
+         * Pointer to integrator
+         */
+        Integrator *m_integrator;
+
+        /**
+         * Temperature and its inverse in energy units
+         */
+        double m_temperature;
+        double m_beta;
+
+        /**
+         * Largest displacement per coordinate
+         */
+        double m_maxdisp;
+
+        /**
+         * Random seed and generator of the serial sweeps
+         */
+        unsigned long m_seed;
+        Random m_random;
+
+        /**
+         * Potential energy of the current configuration
+         */
+        double m_epot;
+
+        /**
+         * Sweep and move counters
+         */
+        int m_nsweeps;
+        long m_ntrial;
+        long m_naccept;
+
+        /**
+         * Each cell and its neighbor cells from the cell pair list
+         */
+        std::vector<std::vector<int> > m_neigh;
+
+        /**
+         * Cells of each checkerboard color
+         */
+        std::vector<std::vector<int> > m_colors;
+
+};
+
+#endif //> !class
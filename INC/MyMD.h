@@ -2,13 +2,44 @@
 #define MD_MYMD_H
 
 #include "Integrator.h"
+#include "Minimizer.h"
+#include "MonteCarlo.h"
+#include "Thermostat.h"
+#include "Rdf.h"
+#include "Correlator.h"
 #include "Force.h"
 #include "Atoms.h"
 #include "Helper.h"
 #include <stdio.h>
+#include <vector>
 
-/* number of MD steps between cell list updates */
-#define cellfreq 4
+class MyMD;
+
+/* Simulation parameters (one per line in the input deck). */
+struct MDParams {
+  int natoms;
+  double mass;
+  double epsilon;
+  double sigma;
+  double rcut;
+  double box[3];   /* box lengths; one number in the deck for a cubic box */
+  double tilt[3];  /* triclinic tilt factors xy, xz, yz */
+  char restfile[BLEN], trajfile[BLEN], ergfile[BLEN];
+  int nsteps;
+  double dt;
+  int nprint;
+
+  MDParams();
+};
+
+/* Energies of the current configuration. */
+struct MDEnergies {
+  int nfi;
+  double temp, ekin, epot, etot, press;
+};
+
+/* Output sink: called at step 0 and every nprint steps. */
+typedef void (*MDOutputFunc)(MyMD *md, void *data);
 
 class MyMD {
   public:
@@ -16,25 +47,61 @@ class MyMD {
     Atoms *atoms;
     Force *force;
     Integrator *integrator;
-   
-    int nsteps;
+    Minimizer *minimizer;
+    MonteCarlo *montecarlo;
+    Thermostat *thermostat;
+    Rdf *rdf;
+    Correlator *msd, *vacf;
+    MDParams params;
+
     int nfi;
     int nthreads;
-    int nprint;
-    double box;
-    char restfile[BLEN], trajfile[BLEN], ergfile[BLEN];
-    FILE *erg, *traj;
+    FILE *erg, *traj, *rdffile, *corrfile;
+    int corrfreq;
 
     /* Methods */
-    MyMD();
+    MyMD(const MDParams &p);
     ~MyMD();
-    void MDLoop();
+    static bool ReadInput(FILE *fp, MDParams *p);
+    bool ReadRestart(const char *fname);
+    bool WriteRestart(const char *fname);
+    bool OpenFiles(bool screen=true);
+    bool OpenRdf(const char *fname, int nbins);
+    bool OpenCorrelators(const char *fname, int freq);
+    bool Setup();
+    void Step(int n);
+    void MDLoop(bool verbose=true);
+    void Minimize(std::string style);
+    void MonteCarloLoop();
+    MDEnergies GetEnergies();
+    bool SetPositions(const double *pos);
+    bool SetVelocities(const double *vel);
+    bool IsMinimizing() { return mode == MODE_MIN; };
+    bool IsMonteCarlo() { return mode == MODE_MC; };
+    void SetThermostat(Thermostat *t) { thermostat = t; };
+    void SetPrintPressure(bool p) { printpress = p; };
+    void SetTeam(bool t) { team = t; };
+
+    /* Output sinks */
+    void AddOutput(MDOutputFunc func, void *data);
+    void ClearOutput();
+    static void OutputScreen(MyMD *md, void *data);
+    static void OutputEnergies(MyMD *md, void *data);
+    static void OutputTrajectory(MyMD *md, void *data);
+    static void OutputRdf(MyMD *md, void *data);
+    static void OutputCorrelators(MyMD *md, void *data);
+
+    void output();
 
   private:
-    bool readInput();
     void allocateMemory();
-    void readRestart();
-    void output();
+    void stepTeam(int n);
+
+    enum { MODE_MD, MODE_MIN, MODE_MC } mode;
+    bool printpress;
+    bool team;
+    std::vector<MDOutputFunc> sinks;
+    std::vector<void *> sinkdata;
 };
 
 #endif
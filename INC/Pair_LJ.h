@@ -8,11 +8,15 @@
 #ifndef MD_PAIR_LJ_H
 #define MD_PAIR_LJ_H
 
+#include <vector>
+#include <string>
 #include "Atoms.h"
 
+class Rdf;
+
 class Pair_LJ {  
  public:
-  Pair_LJ(){}
+  Pair_LJ() : style(LJ_CUT), listmode(LIST_HALF), layout(LAYOUT_SOA), allpairs(true), tail(false), rdf(NULL) {}
   /**
    * Default constructor
    * @param Pointer to atom class
@@ -20,6 +24,12 @@ class Pair_LJ {
   Pair_LJ(double _epsilon, double _sigma){
     epsilon = _epsilon;
     sigma = _sigma;
+    style = LJ_CUT;
+    listmode = LIST_HALF;
+    layout = LAYOUT_SOA;
+    allpairs = true;
+    tail = false;
+    rdf = NULL;
   };
     
   /**
@@ -32,9 +42,179 @@ class Pair_LJ {
    * @return Standard error code
    */
   void ComputeForce(Atoms *atom);
+  /**
+   * Force computer for one thread of a team that runs the whole MD step,
+   * called by all threads of the team: the half list kernel is shared by
+   * the team, other kernels run on the first thread
+   * @param tid Thread number in the team
+   * @param nthreads Size of the team (1: same as without a team)
+   */
+  void ComputeForce(Atoms *atom, int tid, int nthreads);
+  /**
+   * Whether the force computation can be shared by a team that runs the
+   * MD step: the half list kernel with a fixed list and layout
+   */
+  bool TeamKernel(Atoms *atom);
+
+  /**
+   * Force computer on the cell pairs (half list, newtons 3rd law): forces
+   * are accumulated in one copy per thread and reduced afterwards. Runs
+   * the kernel for the selected layout of the slots.
+   */
+  void ComputeForceHalf(Atoms *atom);
+  /**
+   * Half list kernel on slots laid out by the given policy (Layout.h)
+   */
+  template <class Layout> void ComputeForceHalfLayout(Atoms *atom);
+  /**
+   * Half list kernel, run by all threads of a team
+   */
+  template <class Layout> void ComputeForceHalfTeam(Atoms *atom, int tid, int nthreads);
+  /**
+   * Share of one thread in the half list kernel: gather, pair forces and
+   * reduction of the forces
+   * @param _epot,_virial Energy and virial of the pairs of this thread
+   */
+  template <class Layout> void ComputeForceHalfThread(Atoms *atom, int tid, int nthreads,
+                                                      double *_epot, double *_virial);
+  /**
+   * Gather the atoms into slots in cell traversal order and sort each cell
+   * along the three axes, so the half list kernel works on contiguous
+   * memory and can sweep cell pairs along their largest separation. Called
+   * by all threads of the kernel.
+   */
+  template <class Layout> void SortCells(Atoms *atom, int tid, int nthreads);
+  /**
+   * Add tail corrections, count an rdf sample and store energy and virial (end of every kernel)
+   */
+  void StoreEnergies(Atoms *atom, double epot, double virial);
+  /**
+   * Choose the layout of the slots by timing the half list kernel with
+   * each of them
+   */
+  void SelectLayout(Atoms *atom);
+
+  /**
+   * Force computer on the full neighbor cell list: each thread computes the
+   * forces on the atoms of its cells only, twice the pair arithmetic but
+   * no per-thread force copies and no reduction
+   */
+  void ComputeForceFull(Atoms *atom);
+
+  /**
+   * Choose between half and full lists by timing both kernels (with
+   * several threads; a single thread always uses half lists)
+   */
+  void SelectList(Atoms *atom);
+
+  /**
+   * Whether to use the all-pairs kernel: small systems, or cells so coarse
+   * that the cell pairs cover about all pairs of cells (orthorhombic boxes)
+   */
+  bool UseAllPairs(Atoms *atom);
+  /**
+   * Force computer over all pairs of atoms with the minimum image
+   * convention, in tiles dealt out to the threads and without branches
+   * in the inner loop, which beats cell lists for small systems
+   */
+  void ComputeForceAllPairs(Atoms *atom);
+  /**
+   * Force computer on the ghost layout: refreshes the padded positions,
+   * runs over the non-periodic grid and folds ghost forces back to the atoms
+   */
+  void ComputeForceGhost(Atoms *atom);
+
+  /**
+   * Force computer on the cluster pair list: all interactions of a pair of
+   * clusters are computed at once, with cutoff, padding and self pairs masked
+   */
+  void ComputeForceCluster(Atoms *atom);
+
+  /**
+   * Interaction energy of one atom, placed at a trial position, with all
+   * other atoms in the given cells (used by Monte Carlo moves)
+   * @param idx Index of the atom (excluded from the sum)
+   * @param x,y,z Trial position
+   * @param cells Cells to search, usually a cell and its neighbors
+   * @return Energy
+   */
+  double ComputeAtomEnergy(Atoms *atom, int idx, double x, double y, double z,
+                           const std::vector<int> &cells);
   
+  /**
+   * Set variant of the potential at the cutoff
+   * @param style "cut" (truncated), "shift" (energy shifted to zero at the
+   * cutoff) or "sf" (shifted force: force and energy go to zero at the cutoff);
+   * the shifted variants cannot be combined with tail corrections
+   * @return Standard error code
+   */
+  bool SetStyle(std::string _style);
+  /**
+   * Set neighbor list of the cell pair kernel
+   * @param list "half" (newtons 3rd law), "full" (no write conflicts between
+   * threads) or "auto" (the faster one, timed at the first force computation)
+   * @return Standard error code
+   */
+  bool SetList(std::string _list);
+  /**
+   * Set memory layout of positions and forces in the half list kernel
+   * @param layout "soa" (planar), "aos" (xyz of an atom packed and padded),
+   * "aosoa" (planar in blocks of 8 atoms) or "auto" (the fastest one, timed
+   * at the first force computation)
+   * @return Standard error code
+   */
+  bool SetLayout(std::string _layout);
+  /**
+   * Allow the all-pairs kernel for small systems (default) or always
+   * use the cell lists
+   * @return Standard error code
+   */
+  bool SetAllPairs(bool _allpairs);
+  /**
+   * Add long-range tail corrections to energy and virial, assuming a uniform
+   * density beyond the cutoff (truncated potential only: the shifted
+   * variants leave out the shift of the pairs within the cutoff)
+   * @return Standard error code
+   */
+  bool SetTail(bool _tail);
+  /**
+   * Tail corrections of the truncated potential for the atoms and box
+   * @param etail Energy correction
+   * @param wtail Virial correction
+   */
+  void TailCorrection(Atoms *atom, double *etail, double *wtail);
+  /**
+   * Energy shift and force at the cutoff of the selected variant
+   * (zero for the truncated potential)
+   * @param rcut Cutoff radius
+   * @param ecut Energy shift
+   * @param fcut Force at the cutoff, subtracted with shifted forces
+   */
+  void CutoffCoeffs(double rcut, double *ecut, double *fcut);
+  /**
+   * Bin pair distances into a radial distribution function on each force
+   * computation (NULL to disable)
+   */
+  inline void SetRdf(Rdf *_rdf) { rdf = _rdf; };
   /* variables */
   double sigma,epsilon;
+  enum { LJ_CUT, LJ_SHIFT, LJ_SF } style;
+  enum { LIST_HALF, LIST_FULL, LIST_AUTO } listmode;
+  enum { LAYOUT_SOA, LAYOUT_AOS, LAYOUT_AOSOA, LAYOUT_AUTO } layout;
+  bool allpairs;
+  bool tail;
+  Rdf *rdf;
+  /* atoms gathered into slots in cell order: first slot of each cell, atom
+     of each slot and slot of each atom, positions and forces (one copy
+     per thread) in the layout of the kernel */
+  std::vector<int> cellslot, slotatom, atomslot;
+  std::vector<double> slotpos, slotforce;
+  /* slots of each cell sorted per axis (planar), their coordinates along
+     the axis and the cell centers */
+  std::vector<int> sortidx;
+  std::vector<double> sortpos, cellcenter;
+  /* energy and virial of each thread of a team */
+  std::vector<double> teamsum;
 };
 
 #endif //> !class
@@ -0,0 +1,73 @@
+/**
+ * Random class
+ *
+ * @short This class provides a small, fast pseudo random number generator (xorshift64*) with uniform, gaussian and gamma deviates. Each user keeps its own instance, so it is safe to use one per thread or replica.
+ */
+
+#ifndef MD_RANDOM_H
+#define MD_RANDOM_H
+
+//Includes
+#include <math.h>
+#include <stdint.h>
+
+class Random {
+
+    public:
+    /**
+     * Default constructor
+     * @param seed Seed of the generator
+     */
+    Random(uint64_t seed=1) { this->Seed(seed); };
+
+    /**
+     * Default destructor
+     */
+    virtual ~Random() {};
+
+    /**
+     * (Re-)seed the generator
+     * @param seed Seed of the generator
+     */
+    void Seed(uint64_t seed);
+
+    /**
+     * Uniform deviate
+     * @return Random number in (0,1)
+     */
+    inline double Uniform()
+    {
+        this->m_state ^= this->m_state >> 12;
+        this->m_state ^= this->m_state << 25;
+        this->m_state ^= this->m_state >> 27;
+        return ((this->m_state * 2685821657736338717ULL) >> 11) * (1.0/9007199254740992.0) + (0.5/9007199254740992.0);
+    };
+
+    /**
+     * Gaussian deviate
+     * @return Normal distributed random number with zero mean and unit variance
+     */
+    double Gauss();
+
+    /**
+     * Gamma deviate
+     * @param shape Shape parameter (> 0)
+     * @return Gamma distributed random number with unit scale
+     */
+    double Gamma(double shape);
+
+    private:
+        /**
+         * Generator state
+         */
+        uint64_t m_state;
+
+        /**
+         * Second gaussian deviate of the last Box-Muller pair
+         */
+        double m_gauss;
+        bool m_hasgauss;
+
+};
+
+#endif //> !class
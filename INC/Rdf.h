@@ -0,0 +1,108 @@
+/**
+ * Rdf class
+ *
+ * @short This class accumulates the radial distribution function g(r) on the fly: the force kernel bins the squared distances of all pairs within the cutoff into per-thread histograms, which are merged when g(r) is written.
+ */
+
+#ifndef MD_RDF_H
+#define MD_RDF_H
+
+//Includes
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include "Atoms.h"
+
+class Rdf {
+
+    public:
+    /**
+     * Default constructor
+     */
+    Rdf();
+
+    /**
+     * Default destructor
+     */
+    virtual ~Rdf();
+
+    /**
+     * Init
+     * @param nbins Number of bins, equally spaced in r^2 up to the cutoff
+     * @param rcut Cutoff radius
+     * @param nthreads Largest number of threads of the force kernel
+     * @return Standard error code
+     */
+     bool Init(int nbins, double rcut, int nthreads);
+
+    /**
+     * Count one more sample (force evaluation) in the histograms
+     */
+    inline void AddSample() { ++this->m_nsamples; };
+
+    /**
+     * Merge the per-thread histograms into the accumulated one
+     */
+     void Merge();
+
+    /**
+     * Merge and write the accumulated g(r) as one block of the output file
+     * @param fp Open output file
+     * @param atom Pointer to atom class (number of atoms and volume)
+     * @param nfi Step number written to the block header
+     * @return Standard error code
+     */
+     bool Write(FILE *fp, Atoms *atom, int nfi);
+
+    /**
+     * Clear all histograms and the sample counter
+     */
+     void Reset();
+
+    /* ################################################################################ */
+
+    /**
+     * Get histogram of a thread, with one spare bin for round-off at the cutoff
+     */
+     inline long* GetHistogram(int tid) { return &this->m_hist[tid][0]; };
+
+    /**
+     * Get bin index per squared distance: nbins / rcut^2
+     */
+     inline double GetScale() { return this->m_scale; };
+
+    /**
+     * Get number of bins
+     */
+     inline int GetNBins() { return this->m_nbins; };
+
+    /**
+     * Get number of samples
+     */
+     inline long GetNSamples() { return this->m_nsamples; };
+
+    private:
+        /**
+         * Number of bins and the bin index per squared distance
+         */
+        int m_nbins;
+        double m_scale;
+
+        /**
+         * Number of samples since the last reset
+         */
+        long m_nsamples;
+
+        /**
+         * Pair counts per thread since the last merge
+         */
+        std::vector<std::vector<long> > m_hist;
+
+        /**
+         * Accumulated pair counts
+         */
+        std::vector<long> m_total;
+
+};
+
+#endif //> !class
@@ -0,0 +1,107 @@
+/**
+ * ReplicaExchange class
+ *
+ * @short This class provides temperature replica exchange (parallel tempering) on top of the ensemble of replicas. Replicas advance in lock-step batches and exchange temperatures, not coordinates.
+ */
+
+#ifndef MD_REPLICAEXCHANGE_H
+#define MD_REPLICAEXCHANGE_H
+
+//Includes
+#include <stdio.h>
+#include <vector>
+#include "Ensemble.h"
+#include "Thermostat.h"
+#include "Random.h"
+
+class ReplicaExchange : public Ensemble {
+
+    public:
+    /**
+     * Default constructor
+     */
+    ReplicaExchange();
+
+    /**
+     * Default destructor
+     */
+    virtual ~ReplicaExchange();
+
+    /**
+     * Read replica exchange input: exchange interval, thermostat time constant,
+     * random seed, log file name, then one input deck and temperature per line
+     * @param fp Pointer to input file
+     * @return Standard error code
+     */
+     bool ReadInput(FILE *fp);
+
+    /**
+     * Setup replicas and attach one thermostat per replica
+     * @return Standard error code
+     */
+     virtual bool Setup();
+
+    /**
+     * Run batches of MD steps, attempting exchanges in between
+     * @return Standard error code
+     */
+     virtual bool Run();
+
+    private:
+        /**
+         * Attempt Metropolis swaps between neighboring temperatures
+         * @param parity Start with temperature pair (0,1) for 0 or (1,2) for 1
+         */
+         void Exchange(int parity);
+
+        /**
+         * MD steps between exchange attempts
+         */
+        int m_nexchange;
+
+        /**
+         * Thermostat time constant
+         */
+        double m_tau;
+
+        /**
+         * Random seed
+         */
+        unsigned long m_seed;
+
+        /**
+         * Exchange log file
+         */
+        char m_logfile[BLEN];
+        FILE *m_log;
+
+        /**
+         * Temperature ladder (ascending)
+         */
+        std::vector<double> m_temps;
+
+        /**
+         * Maps replica -> temperature index and temperature index -> replica
+         */
+        std::vector<int> m_rep2temp;
+        std::vector<int> m_temp2rep;
+
+        /**
+         * One thermostat per replica
+         */
+        std::vector<Thermostat*> m_thermostats;
+
+        /**
+         * Exchange statistics per pair of neighboring temperatures
+         */
+        std::vector<long> m_attempts;
+        std::vector<long> m_accepts;
+
+        /**
+         * Random number generator for exchange decisions
+         */
+        Random m_random;
+
+};
+
+#endif //> !class
@@ -0,0 +1,95 @@
+/**
+ * Thermostat class
+ *
+ * @short This class provides stochastic velocity rescaling (Bussi, Donadio and Parrinello, J. Chem. Phys. 126, 014101 (2007)) applied after each integrator step
+ */
+
+#ifndef MD_THERMOSTAT_H
+#define MD_THERMOSTAT_H
+
+//Includes
+#include <math.h>
+#include "Atoms.h"
+#include "Random.h"
+
+class Thermostat {
+
+    public:
+    /**
+     * Default constructor
+     */
+    Thermostat();
+
+    /**
+     * Default destructor
+     */
+    virtual ~Thermostat();
+
+    /**
+     * Init
+     * @param Pointer to atom class
+     * @param seed Seed of the random number generator
+     * @return Standard error code
+     */
+     bool Init(Atoms *atom, unsigned long seed);
+
+    /**
+     * Rescale velocities towards the target temperature
+     * @param timestep MD time step
+     * @return Standard error code
+     */
+     bool Apply(double timestep);
+
+    /**
+     * Change target temperature, rescaling velocities by sqrt(Tnew/Told)
+     * @param temp New target temperature
+     * @return Standard error code
+     */
+     bool ExchangeTemp(double temp);
+
+    /**
+     * Set target temperature
+     */
+    inline void SetTemp(double temp) { this->m_temperature = temp; };
+
+    /**
+     * Set relaxation time
+     */
+    inline void SetTau(double tau) { this->m_tau = tau; };
+
+    /* ################################################################################ */
+
+    /**
+     * Get target temperature
+     */
+     double GetTemp() { return this->m_temperature; };
+
+    /**
+     * Get relaxation time
+     */
+     double GetTau() { return this->m_tau; };
+
+    private:
+        /**
+         * Pointer to atoms
+         */
+        Atoms *m_atom;
+
+        /**
+         * Target temperature
+         */
+        double m_temperature;
+
+        /**
+         * Relaxation time
+         */
+        double m_tau;
+
+        /**
+         * Random number generator
+         */
+        Random m_random;
+
+};
+
+#endif //> !class
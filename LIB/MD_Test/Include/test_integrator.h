@@ -9,19 +9,10 @@
 
 #include <iostream>
 #include <math.h>
-#include "mpi.h"
 #include "gtest/gtest.h"
 #include "MyMD.h"
-#include "Atom.h"
+#include "Atoms.h"
 #include "Pair_LJ.h"
 #include "Integrator.h"
 
-class IntegratorTest{
- protected:
-  IntegratorTest();
-  virtual ~IntegratorTest();
-  virtual void Setup();
-  virtual void TearDown();
-};
-
 #endif
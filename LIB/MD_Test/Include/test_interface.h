@@ -9,20 +9,14 @@
 
 #include <iostream>
 #include <math.h>
-#include "mpi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+#include <vector>
 #include "gtest/gtest.h"
 #include "MyMD.h"
-#include "Atom.h"
+#include "Atoms.h"
 #include "Pair_LJ.h"
 #include "Integrator.h"
 
-class IntefaceTest{
- protected:
-  InterfaceTest();
-  virtual ~InterfaceTest();
-  virtual void Setup();
-  virtual void TearDown();
-  
-};
-
 #endif
@@ -0,0 +1,18 @@
+/* TestMinimizer()
+ * 
+ * Header file for Minimizer Test
+ *
+ */
+
+#ifndef TEST_MINIMIZER
+#define TEST_MINIMIZER
+
+#include <iostream>
+#include <math.h>
+#include "gtest/gtest.h"
+#include "MyMD.h"
+#include "Atoms.h"
+#include "Pair_LJ.h"
+#include "Minimizer.h"
+
+#endif
@@ -9,18 +9,9 @@
 
 #include <iostream>
 #include <math.h>
-#include "mpi.h"
 #include "gtest/gtest.h"
 #include "MyMD.h"
-#include "Atom.h"
+#include "Atoms.h"
 #include "Pair_LJ.h"
 
-class PairLJTest{
- protected:
-  PairLJTest();
-  virtual ~PairLJTest();
-  virtual void Setup();
-  virtual void TearDown();
-};
-
 #endif
@@ -3,10 +3,12 @@
 using namespace std;
 namespace {
 
+  const int natoms = 16;
+
   class IntegratorTest : public ::testing::Test {
   protected:
     IntegratorTest() {
-      
+      seed = 2013;
     }
     
     virtual ~IntegratorTest(){
@@ -15,8 +17,9 @@ namespace {
     
     /* Pre Test Initializations go in here  */
     /* To be run before every test          */
-    virtual void Setup() {
-      
+    virtual void SetUp() {
+      ASSERT_TRUE(atom.Init(natoms));
+      atom.ClearImages();
     }
     
     /* Post Test deconstructions go in here */
@@ -24,11 +27,151 @@ namespace {
     virtual void TearDown() {
       
     } 
+
+    /* Uniform random number in -0.5..0.5 */
+    double Random() {
+      seed = 1103515245u*seed + 12345u;
+      return (seed >> 16)/65536.0 - 0.5;
+    }
+
+    /* Box vectors a=(lx,0,0), b=(xy,ly,0), c=(xz,yz,lz) */
+    void BoxVectors(double *a, double *b, double *c) {
+      a[0] = atom.GetBoxSize(0); a[1] = 0.0;                 a[2] = 0.0;
+      b[0] = atom.GetBoxTilt(0); b[1] = atom.GetBoxSize(1);  b[2] = 0.0;
+      c[0] = atom.GetBoxTilt(1); c[1] = atom.GetBoxTilt(2);  c[2] = atom.GetBoxSize(2);
+    }
+
+    /* Place the atoms up to three box vectors away from the box, keeping
+       the positions and the image shifts they were given */
+    void Scatter(double *r0, int *shift) {
+      double a[3], b[3], c[3];
+      BoxVectors(a, b, c);
+      for (int i=0; i<natoms; ++i) {
+        double s[3] = { Random(), Random(), Random() }, r[3];
+        int n[3];
+        atom.FromFractional(s, r);
+        for (int d=0; d<3; ++d) n[d] = (int)rint(6.0*Random());
+        for (int d=0; d<3; ++d) {
+          r0[d*natoms + i] = r[d] + n[0]*a[d] + n[1]*b[d] + n[2]*c[d];
+          shift[d*natoms + i] = n[d];
+          atom.SetPosition(d*natoms + i, r0[d*natoms + i]);
+        }
+      }
+    }
+
+    Atoms atom;
+    unsigned int seed;
   };
-  
-  /* Example Test to test the wrong coeff */
-  TEST_F(IntegratorTest, WrongCoeff) {
-    
+
+  /* Wrapped positions lie in the box, the image counters record the box
+     vectors they were shifted by, and unwrapping restores the input */
+  TEST_F(IntegratorTest, WrapTiltedBox) {
+    double r0[3*natoms], s[3];
+    int shift[3*natoms], *img = atom.GetImage();
+
+    atom.SetBoxSize(10.0, 11.0, 12.0, 2.5, -3.0, 1.5);
+    ASSERT_TRUE(atom.IsTriclinic());
+    Scatter(r0, shift);
+    for (int i=0; i<natoms; ++i) atom.WrapPosition(i);
+
+    for (int i=0; i<natoms; ++i) {
+      atom.ToFractional(atom.GetPosition(i), atom.GetPosition(natoms+i), atom.GetPosition(2*natoms+i), s);
+      for (int d=0; d<3; ++d) {
+        int idx = d*natoms + i;
+        EXPECT_LE(fabs(s[d]), 0.5 + 1.0e-12);
+        EXPECT_EQ(shift[idx], img[idx]);
+        EXPECT_NEAR(r0[idx] - atom.GetPosition(idx), atom.GetImageOffset(idx), 1.0e-10);
+        EXPECT_NEAR(r0[idx], atom.GetUnwrappedPosition(idx), 1.0e-10);
+      }
+    }
+
+    /* counters are reset, e.g. for new positions */
+    atom.ClearImages();
+    for (int i=0; i<3*natoms; ++i) EXPECT_EQ(0.0, atom.GetImageOffset(i));
+  }
+
+  /* Wrapping again after further moves accumulates the image counters,
+     and the split into GetWrappedPosition and ShiftPosition agrees */
+  TEST_F(IntegratorTest, ImageCountersAccumulate) {
+    double r0[3*natoms], r1[3*natoms], r[3], a[3], b[3], c[3];
+    int shift[3*natoms], n[3], *img = atom.GetImage();
+
+    atom.SetBoxSize(10.0, 11.0, 12.0, 2.5, -3.0, 1.5);
+    BoxVectors(a, b, c);
+    Scatter(r0, shift);
+    for (int i=0; i<natoms; ++i) atom.WrapPosition(i);
+
+    /* move by 2a - b + 3c plus a bit, then wrap in two steps */
+    for (int i=0; i<natoms; ++i) {
+      for (int d=0; d<3; ++d) {
+        int idx = d*natoms + i;
+        r1[idx] = r0[idx] + 2.0*a[d] - b[d] + 3.0*c[d] + 0.3*Random();
+        atom.SetPosition(idx, atom.GetPosition(idx) + r1[idx] - r0[idx]);
+      }
+      atom.GetWrappedPosition(i, r, n);
+      atom.ShiftPosition(i, n);
+      for (int d=0; d<3; ++d) {
+        int idx = d*natoms + i;
+        EXPECT_EQ(r[d], atom.GetPosition(idx));
+        EXPECT_EQ(img[idx], shift[idx] + n[d]);
+        EXPECT_NEAR(r1[idx], atom.GetUnwrappedPosition(idx), 1.0e-10);
+      }
+    }
+  }
+
+  /* The minimum image of a distance shorter than half the box width
+     is the distance itself, however far the atoms were wrapped */
+  TEST_F(IntegratorTest, MinimumImageTiltedBox) {
+    double r0[3*natoms], a[3], b[3], c[3], wmin;
+    int shift[3*natoms];
+
+    atom.SetBoxSize(10.0, 11.0, 12.0, 2.5, -3.0, 1.5);
+    BoxVectors(a, b, c);
+    wmin = min(atom.GetBoxWidth(0), min(atom.GetBoxWidth(1), atom.GetBoxWidth(2)));
+    Scatter(r0, shift);
+    for (int i=0; i<natoms; ++i) atom.WrapPosition(i);
+
+    for (int i=0; i<natoms; ++i) {
+      double dr[3], d[3], len = 0.0;
+      int n[3];
+
+      /* a distance vector well within half the box width, to an image
+         of the atom a few box vectors away */
+      for (int k=0; k<3; ++k) dr[k] = 0.5*wmin*Random();
+      for (int k=0; k<3; ++k) n[k] = (int)rint(4.0*Random());
+      for (int k=0; k<3; ++k) len += dr[k]*dr[k];
+      ASSERT_LT(sqrt(len), 0.5*wmin);
+      for (int k=0; k<3; ++k) {
+        double p = r0[k*natoms + i] + dr[k] + n[0]*a[k] + n[1]*b[k] + n[2]*c[k];
+        d[k] = p - atom.GetPosition(k*natoms + i);
+      }
+      atom.MinImage(d);
+      for (int k=0; k<3; ++k) EXPECT_NEAR(dr[k], d[k], 1.0e-10);
+    }
+  }
+
+  /* Distance of opposite faces: volume over the area of the face */
+  TEST_F(IntegratorTest, BoxWidth) {
+    double a[3], b[3], c[3], cross[3][3], vol, area;
+
+    atom.SetBoxSize(10.0, 11.0, 12.0);
+    EXPECT_FALSE(atom.IsTriclinic());
+    for (int d=0; d<3; ++d) EXPECT_DOUBLE_EQ(atom.GetBoxSize(d), atom.GetBoxWidth(d));
+
+    atom.SetBoxSize(10.0, 11.0, 12.0, 2.5, -3.0, 1.5);
+    BoxVectors(a, b, c);
+    vol = atom.GetVolume();
+    const double *u[3][2] = { { b, c }, { c, a }, { a, b } };
+    for (int d=0; d<3; ++d) {
+      const double *p = u[d][0], *q = u[d][1];
+      cross[d][0] = p[1]*q[2] - p[2]*q[1];
+      cross[d][1] = p[2]*q[0] - p[0]*q[2];
+      cross[d][2] = p[0]*q[1] - p[1]*q[0];
+      area = sqrt(cross[d][0]*cross[d][0] + cross[d][1]*cross[d][1] + cross[d][2]*cross[d][2]);
+      EXPECT_NEAR(vol/area, atom.GetBoxWidth(d), 1.0e-12*vol/area);
+      EXPECT_LE(atom.GetBoxWidth(d), atom.GetBoxSize(d));
+    }
+    EXPECT_NEAR(vol, a[0]*cross[0][0] + a[1]*cross[0][1] + a[2]*cross[0][2], 1.0e-10*vol);
   }
 }
 
@@ -3,10 +3,32 @@
 using namespace std;
 namespace {
 
+  /* orthorhombic example deck and its reference output */
+  const char *restfile = "../../examples/argon_ortho_240.rest";
+  const char *reffile = "../../reference/argon_ortho_240.dat";
+
+  /* In-memory sink: keeps the energies of every output */
+  void CollectEnergies(MyMD *md, void *data) {
+    ((vector<MDEnergies> *)data)->push_back(md->GetEnergies());
+  }
+
   class InterfaceTest : public ::testing::Test {
   protected:
-    IntegratorTest() {
-      
+    InterfaceTest() {
+      params.natoms = 240;
+      params.mass = 39.948;
+      params.epsilon = 0.2379;
+      params.sigma = 3.405;
+      params.rcut = 8.5;
+      params.box[0] = 17.158;
+      params.box[1] = 22.877333;
+      params.box[2] = 28.596667;
+      params.nsteps = 300;
+      params.dt = 5.0;
+      params.nprint = 100;
+      md = NULL;
+      buf = NULL;
+      len = 0;
     }
     
     virtual ~InterfaceTest(){
@@ -15,20 +37,81 @@ namespace {
     
     /* Pre Test Initializations go in here  */
     /* To be run before every test          */
-    virtual void Setup() {
-      
+    virtual void SetUp() {
+      md = new MyMD(params);
+      ASSERT_TRUE(md->ReadRestart(restfile));
+      ASSERT_TRUE(md->Setup());
+      thermo = open_memstream(&buf, &len);
+      ASSERT_TRUE(thermo != NULL);
+      md->AddOutput(CollectEnergies, &energies);
+      md->AddOutput(MyMD::OutputEnergies, thermo);
     }
     
     /* Post Test deconstructions go in here */
     /* To be run before every test          */
     virtual void TearDown() {
-      
+      delete md;
+      fclose(thermo);
+      free(buf);
     } 
+
+    /* The thermo lines written to memory and the collected energies
+       agree with the first lines of the reference output */
+    void CheckThermo(int nlines) {
+      FILE *ref = fopen(reffile, "r");
+      istringstream out;
+      double e[5], r[5];
+
+      ASSERT_TRUE(ref != NULL);
+      fflush(thermo);
+      out.str(string(buf, len));
+      ASSERT_EQ(nlines, (int)energies.size());
+      for (int k=0; k<nlines; ++k) {
+        ASSERT_FALSE((out >> e[0] >> e[1] >> e[2] >> e[3] >> e[4]).fail());
+        ASSERT_EQ(5, fscanf(ref, "%lf%lf%lf%lf%lf", &r[0], &r[1], &r[2], &r[3], &r[4]));
+        EXPECT_EQ(r[0], e[0]);
+        for (int i=1; i<5; ++i) EXPECT_NEAR(r[i], e[i], 2.0e-8);
+
+        EXPECT_EQ(k*params.nprint, energies[k].nfi);
+        EXPECT_NEAR(e[1], energies[k].temp, 1.0e-8);
+        EXPECT_NEAR(e[2], energies[k].ekin, 1.0e-8);
+        EXPECT_NEAR(e[3], energies[k].epot, 1.0e-8);
+        EXPECT_NEAR(e[4], energies[k].etot, 1.0e-8);
+        EXPECT_DOUBLE_EQ(energies[k].ekin + energies[k].epot, energies[k].etot);
+      }
+      EXPECT_TRUE((out >> e[0]).fail());
+      fclose(ref);
+    }
+
+    MDParams params;
+    MyMD *md;
+    vector<MDEnergies> energies;
+    FILE *thermo;
+    char *buf;
+    size_t len;
   };
   
-  /* Example Test to test the wrong coeff */
-  TEST_F(InterfaceTest, WrongCoeff) {
-    
+  /* A run driven from MDParams writes its thermo output only to the sinks */
+  TEST_F(InterfaceTest, MDLoopToSinks) {
+    md->MDLoop(false);
+    CheckThermo(4);
+  }
+
+  /* Stepping in pieces gives the same output as one run */
+  TEST_F(InterfaceTest, StepInPieces) {
+    md->output();
+    for (int k=0; k<6; ++k) md->Step(50);
+    CheckThermo(4);
+    EXPECT_EQ(300, md->GetEnergies().nfi);
+  }
+
+  /* No output without sinks */
+  TEST_F(InterfaceTest, ClearOutput) {
+    md->ClearOutput();
+    md->MDLoop(false);
+    fflush(thermo);
+    EXPECT_EQ(0u, len);
+    EXPECT_EQ(0u, energies.size());
   }
 }
 
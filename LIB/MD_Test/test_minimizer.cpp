@@ -0,0 +1,129 @@
+#include "test_minimizer.h"
+
+using namespace std;
+
+namespace {
+
+  /* argon parameters of the example decks */
+  const double eps = 0.2379;
+  const double sig = 3.405;
+
+  /* global minimum of the 13 atom LJ cluster (icosahedron) in units of eps */
+  const double elj13 = -44.326801;
+
+  class MinimizerTest : public ::testing::Test {
+  protected:
+    MinimizerTest() {
+      params.natoms = 13;
+      params.mass = 39.948;
+      params.epsilon = eps;
+      params.sigma = sig;
+      params.rcut = 12.0;   /* all pairs of the cluster within the cutoff */
+      params.box[0] = params.box[1] = params.box[2] = 40.0;
+      params.dt = 5.0;
+      md = NULL;
+    }
+
+    virtual ~MinimizerTest(){
+
+    }
+
+    /* Pre Test Initializations go in here  */
+    /* To be run before every test          */
+    virtual void SetUp() {
+
+    }
+
+    /* Post Test deconstructions go in here */
+    /* To be run before every test          */
+    virtual void TearDown() {
+      delete md;
+    }
+
+    /* Distorted icosahedron around an atom in the origin, minimized
+       until the minimizer stops (at most 2000 iterations) */
+    void Minimize(string style, double ftol, double etol) {
+      const double phi = 0.5*(1.0 + sqrt(5.0));
+      const double scale = 1.09*sig / sqrt(1.0 + phi*phi);
+      double pos[39];
+      unsigned int seed = 4711;
+      int i, n = 13;
+
+      for (i=0; i<39; ++i) pos[i] = 0.0;
+      for (i=0; i<12; ++i) {
+        double u = (i & 1) ? -1.0 : 1.0, v = (i & 2) ? -phi : phi;
+        int c = i/4;
+        pos[((c+1)%3)*n + i+1] = u*scale;
+        pos[((c+2)%3)*n + i+1] = v*scale;
+      }
+      for (i=0; i<39; ++i) {
+        seed = 1103515245u*seed + 12345u;
+        pos[i] += 0.1*sig*((seed >> 16)/65536.0 - 0.5);
+      }
+
+      md = new MyMD(params);
+      md->SetPositions(pos);
+      ASSERT_TRUE(md->Setup());
+      ASSERT_TRUE(md->minimizer->SetStyle(style));
+      md->minimizer->SetForceTol(ftol);
+      md->minimizer->SetEnergyTol(etol);
+      md->minimizer->SetTimestep(params.dt);
+      ASSERT_TRUE(md->minimizer->Setup());
+      for (i=0; i<2000 && !md->minimizer->IsStopped(); ++i) md->minimizer->Iterate();
+    }
+
+    MDParams params;
+    MyMD *md;
+  };
+
+  TEST_F(MinimizerTest, FireForceTolerance) {
+    Minimize("fire", 1.0e-4, 0.0);
+    EXPECT_TRUE(md->minimizer->IsConverged());
+    EXPECT_EQ("max force below tolerance", md->minimizer->GetStopReason());
+    EXPECT_LT(md->minimizer->GetMaxForce(), 1.0e-4);
+    EXPECT_NEAR(elj13*eps, md->atoms->GetPotEnergy(), 1.0e-7*fabs(elj13*eps));
+  }
+
+  TEST_F(MinimizerTest, FireEnergyTolerance) {
+    Minimize("fire", 0.0, 1.0e-8);
+    EXPECT_TRUE(md->minimizer->IsConverged());
+    EXPECT_EQ("energy change below tolerance", md->minimizer->GetStopReason());
+    EXPECT_GT(md->minimizer->GetMaxForce(), 0.0);
+    EXPECT_NEAR(elj13*eps, md->atoms->GetPotEnergy(), 1.0e-5*fabs(elj13*eps));
+  }
+
+  TEST_F(MinimizerTest, CGForceTolerance) {
+    Minimize("cg", 1.0e-4, 0.0);
+    EXPECT_TRUE(md->minimizer->IsConverged());
+    EXPECT_EQ("max force below tolerance", md->minimizer->GetStopReason());
+    EXPECT_LT(md->minimizer->GetMaxForce(), 1.0e-4);
+    EXPECT_NEAR(elj13*eps, md->atoms->GetPotEnergy(), 1.0e-7*fabs(elj13*eps));
+  }
+
+  TEST_F(MinimizerTest, CGEnergyTolerance) {
+    Minimize("cg", 0.0, 1.0e-8);
+    EXPECT_TRUE(md->minimizer->IsConverged());
+    EXPECT_EQ("energy change below tolerance", md->minimizer->GetStopReason());
+    EXPECT_GT(md->minimizer->GetMaxForce(), 0.0);
+    EXPECT_NEAR(elj13*eps, md->atoms->GetPotEnergy(), 1.0e-5*fabs(elj13*eps));
+  }
+
+  /* The force evaluations are counted and CG needs fewer than FIRE */
+  TEST_F(MinimizerTest, CGFewerForceEvaluations) {
+    int nfire;
+    Minimize("fire", 1.0e-4, 0.0);
+    nfire = md->minimizer->GetNForceEval();
+    delete md;
+    md = NULL;
+    Minimize("cg", 1.0e-4, 0.0);
+    EXPECT_GT(md->minimizer->GetNForceEval(), 0);
+    EXPECT_LT(md->minimizer->GetNForceEval(), nfire);
+  }
+}
+
+/* Run the actual test                  */
+int main(int argc, char **argv){
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+
@@ -4,33 +4,266 @@ using namespace std;
 
 namespace {
 
+  /* argon parameters of the example decks, cutoff of 2.5 sigma */
+  const double eps = 0.2379;
+  const double sig = 3.405;
+  const double rc = 8.5;
+
   class PairLJTest : public ::testing::Test {
   protected:
     PairLJTest() {
-      
+      params.natoms = 2;
+      params.mass = 39.948;
+      params.epsilon = eps;
+      params.sigma = sig;
+      params.rcut = rc;
+      params.box[0] = params.box[1] = params.box[2] = 30.0;
+      params.dt = 5.0;
+      md = NULL;
     }
-    
+
     virtual ~PairLJTest(){
-      
+
     }
-    
+
     /* Pre Test Initializations go in here  */
     /* To be run before every test          */
-    virtual void Setup() {
-      
+    virtual void SetUp() {
+
     }
-    
+
     /* Post Test deconstructions go in here */
     /* To be run before every test          */
     virtual void TearDown() {
-      
-    }    
+      delete md;
+    }
+
+    /* Two atoms r apart along x, forces and energies computed */
+    bool SetupPair(double r, string style, bool tail) {
+      double pos[6] = { -0.5*r, 0.5*r, 0.0, 0.0, 0.0, 0.0 };
+
+      md = new MyMD(params);
+      if (!md->force->pair->LJ->SetStyle(style) || !md->force->pair->LJ->SetTail(tail))
+        return false;
+      md->SetPositions(pos);
+      return md->Setup();
+    }
+
+    /* Truncated potential and the magnitude of its force */
+    static double Energy(double r) {
+      double sr6 = pow(sig/r, 6.0);
+      return 4.0*eps*sr6*(sr6 - 1.0);
+    }
+    static double Force(double r) {
+      double sr6 = pow(sig/r, 6.0);
+      return 24.0*eps*sr6*(2.0*sr6 - 1.0)/r;
+    }
+
+    /* Force on the second atom along x and on the first one */
+    void ExpectForce(double f) {
+      double *frc = md->atoms->GetForce();
+      EXPECT_NEAR(f, frc[1], 1.0e-10*fabs(f) + 1.0e-12);
+      EXPECT_NEAR(-f, frc[0], 1.0e-10*fabs(f) + 1.0e-12);
+      for (int i=2; i<6; ++i) EXPECT_EQ(0.0, frc[i]);
+    }
+
+    MDParams params;
+    MyMD *md;
+  };
+
+  TEST_F(PairLJTest, TruncatedInsideCutoff) {
+    const double r[] = { 3.6, 4.5, 8.4 };
+    for (int k=0; k<3; ++k) {
+      ASSERT_TRUE(SetupPair(r[k], "cut", false));
+      EXPECT_NEAR(Energy(r[k]), md->atoms->GetPotEnergy(), 1.0e-10*fabs(Energy(r[k])));
+      EXPECT_NEAR(r[k]*Force(r[k]), md->atoms->GetVirial(), 1.0e-10*fabs(r[k]*Force(r[k])));
+      ExpectForce(Force(r[k]));
+      delete md;
+      md = NULL;
+    }
+  }
+
+  TEST_F(PairLJTest, ShiftedInsideCutoff) {
+    const double r[] = { 3.6, 4.5, 8.4 };
+    for (int k=0; k<3; ++k) {
+      double e = Energy(r[k]) - Energy(rc);
+      ASSERT_TRUE(SetupPair(r[k], "shift", false));
+      EXPECT_NEAR(e, md->atoms->GetPotEnergy(), 1.0e-10*fabs(Energy(r[k])));
+      EXPECT_NEAR(r[k]*Force(r[k]), md->atoms->GetVirial(), 1.0e-10*fabs(r[k]*Force(r[k])));
+      ExpectForce(Force(r[k]));
+      delete md;
+      md = NULL;
+    }
+  }
+
+  TEST_F(PairLJTest, ShiftedForceInsideCutoff) {
+    const double r[] = { 3.6, 4.5, 8.4 };
+    for (int k=0; k<3; ++k) {
+      double e = Energy(r[k]) - Energy(rc) + Force(rc)*(r[k] - rc);
+      double f = Force(r[k]) - Force(rc);
+      ASSERT_TRUE(SetupPair(r[k], "sf", false));
+      EXPECT_NEAR(e, md->atoms->GetPotEnergy(), 1.0e-10*fabs(Energy(r[k])));
+      EXPECT_NEAR(r[k]*f, md->atoms->GetVirial(), 1.0e-10*fabs(r[k]*Force(r[k])));
+      ExpectForce(f);
+      delete md;
+      md = NULL;
+    }
+  }
+
+  /* Pairs at the cutoff do not interact in any variant */
+  TEST_F(PairLJTest, NothingAtCutoff) {
+    const char *style[] = { "cut", "shift", "sf" };
+    for (int k=0; k<3; ++k) {
+      ASSERT_TRUE(SetupPair(rc, style[k], false));
+      EXPECT_EQ(0.0, md->atoms->GetPotEnergy());
+      EXPECT_EQ(0.0, md->atoms->GetVirial());
+      ExpectForce(0.0);
+      delete md;
+      md = NULL;
+    }
+  }
+
+  /* Beyond the cutoff only the tail corrections remain:
+     8/3 pi N rho eps sig^3 ((sig/rc)^9/3 - (sig/rc)^3) and
+     16 pi N rho eps sig^3 (2/3 (sig/rc)^9 - (sig/rc)^3) */
+  TEST_F(PairLJTest, TailCorrection) {
+    double rho = 2.0/(30.0*30.0*30.0);
+    double sr3 = pow(sig/rc, 3.0);
+    double sr9 = sr3*sr3*sr3;
+    double etail = 8.0/3.0*M_PI*2.0*rho*eps*pow(sig, 3.0)*(sr9/3.0 - sr3);
+    double wtail = 16.0*M_PI*2.0*rho*eps*pow(sig, 3.0)*(2.0/3.0*sr9 - sr3);
+
+    ASSERT_TRUE(SetupPair(12.0, "cut", true));
+    EXPECT_NEAR(etail, md->atoms->GetPotEnergy(), 1.0e-12*fabs(etail));
+    EXPECT_NEAR(wtail, md->atoms->GetVirial(), 1.0e-12*fabs(wtail));
+    ExpectForce(0.0);
+    delete md;
+
+    /* inside the cutoff the tail is added to the pair energy */
+    md = NULL;
+    ASSERT_TRUE(SetupPair(4.5, "cut", true));
+    EXPECT_NEAR(Energy(4.5) + etail, md->atoms->GetPotEnergy(), 1.0e-10*fabs(Energy(4.5)));
+    EXPECT_NEAR(4.5*Force(4.5) + wtail, md->atoms->GetVirial(), 1.0e-10*fabs(4.5*Force(4.5)));
+  }
+
+  /* The tail only applies to the truncated potential, in either call order */
+  TEST_F(PairLJTest, TailOnlyWhenTruncated) {
+    Pair_LJ lj;
+    EXPECT_TRUE(lj.SetTail(true));
+    EXPECT_FALSE(lj.SetStyle("shift"));
+    EXPECT_FALSE(lj.SetStyle("sf"));
+    EXPECT_TRUE(lj.SetStyle("cut"));
+    EXPECT_TRUE(lj.SetTail(false));
+    EXPECT_TRUE(lj.SetStyle("sf"));
+    EXPECT_FALSE(lj.SetTail(true));
+    EXPECT_TRUE(lj.SetStyle("shift"));
+    EXPECT_FALSE(lj.SetTail(true));
+    EXPECT_FALSE(lj.SetStyle("lj"));
+  }
+
+  /* Kernel options of the force computation */
+  struct KernelOption {
+    const char *name;
+    const char *list;
+    const char *layout;
+    bool ghost, cluster, allpairs;
+  };
+
+  ostream &operator<<(ostream &os, const KernelOption &opt) {
+    return os << opt.name;
+  }
+
+  /* Perturbed fcc lattice of 320 atoms in an orthorhombic box, small enough
+     for the all-pairs kernel to be chosen when allowed. Forces
+     of the half list kernel with planar slots are the reference */
+  class PairLJKernelTest : public ::testing::TestWithParam<KernelOption> {
+  protected:
+    PairLJKernelTest() {
+      const double a = 5.26;
+      const int nx = 4, ny = 4, nz = 5;
+      int i, j, k, b, n = 0;
+      unsigned int seed = 12345;
+
+      params.natoms = 4*nx*ny*nz;
+      params.mass = 39.948;
+      params.epsilon = eps;
+      params.sigma = sig;
+      params.rcut = rc;
+      params.box[0] = nx*a;
+      params.box[1] = ny*a;
+      params.box[2] = nz*a;
+      params.dt = 5.0;
+
+      pos.resize(3*params.natoms);
+      for (i=0; i<nx; ++i) for (j=0; j<ny; ++j) for (k=0; k<nz; ++k) for (b=0; b<4; ++b) {
+        double r[3] = { (i + 0.5*(b==1 || b==2))*a, (j + 0.5*(b==1 || b==3))*a, (k + 0.5*(b==2 || b==3))*a };
+        for (int d=0; d<3; ++d) {
+          seed = 1103515245u*seed + 12345u;
+          pos[d*params.natoms + n] = r[d] - 0.5*params.box[d] + 0.6*((seed >> 16)/65536.0 - 0.5);
+        }
+        ++n;
+      }
+    }
+
+    /* Set up forces and energies with the given kernel options */
+    MyMD *Run(const KernelOption &opt) {
+      MyMD *md = new MyMD(params);
+      md->integrator->SetGhost(opt.ghost);
+      md->integrator->SetCluster(opt.cluster);
+      EXPECT_TRUE(md->force->pair->LJ->SetList(opt.list));
+      EXPECT_TRUE(md->force->pair->LJ->SetLayout(opt.layout));
+      EXPECT_TRUE(md->force->pair->LJ->SetAllPairs(opt.allpairs));
+      md->SetPositions(&pos[0]);
+      EXPECT_TRUE(md->Setup());
+      return md;
+    }
+
+    MDParams params;
+    vector<double> pos;
   };
-  
-  /* Example Test to test the wrong coeff */
-  TEST_F(PairLJTest, WrongCoeff) {
-    
+
+  /* All kernels give the forces, energy and virial of the reference */
+  TEST_P(PairLJKernelTest, SameForces) {
+    const KernelOption ref = { "half-soa", "half", "soa", false, false, false };
+    const KernelOption &opt = GetParam();
+    MyMD *md0 = Run(ref);
+    MyMD *md = Run(opt);
+    int n3 = 3*params.natoms;
+    double *f0 = md0->atoms->GetForce(), *f = md->atoms->GetForce();
+    double e0 = md0->atoms->GetPotEnergy(), w0 = md0->atoms->GetVirial();
+
+    /* the options select the kernel they name */
+    EXPECT_EQ(opt.ghost, md->atoms->UseGhosts());
+    EXPECT_EQ(opt.cluster, md->atoms->GetClusters() != NULL);
+    EXPECT_EQ(opt.allpairs, md->force->pair->LJ->UseAllPairs(md->atoms));
+
+    ASSERT_LT(e0, 0.0);
+    EXPECT_NEAR(e0, md->atoms->GetPotEnergy(), 1.0e-10*fabs(e0));
+    EXPECT_NEAR(w0, md->atoms->GetVirial(), 1.0e-10*fabs(w0));
+    for (int i=0; i<n3; ++i) EXPECT_NEAR(f0[i], f[i], 1.0e-10);
+
+    /* and keep doing so while atoms migrate between cells */
+    md0->Step(20);
+    md->Step(20);
+    e0 = md0->atoms->GetPotEnergy();
+    EXPECT_NEAR(e0, md->atoms->GetPotEnergy(), 1.0e-8*fabs(e0));
+    EXPECT_NEAR(md0->atoms->GetVirial(), md->atoms->GetVirial(), 1.0e-8*fabs(w0));
+
+    delete md;
+    delete md0;
   }
+
+  const KernelOption kernels[] = {
+    { "half-soa",   "half", "soa",   false, false, false },
+    { "half-aos",   "half", "aos",   false, false, false },
+    { "half-aosoa", "half", "aosoa", false, false, false },
+    { "full",       "full", "soa",   false, false, false },
+    { "ghost",      "half", "soa",   true,  false, false },
+    { "cluster",    "half", "soa",   false, true,  false },
+    { "allpairs",   "half", "soa",   false, false, true  }
+  };
+
+  INSTANTIATE_TEST_CASE_P(Kernels, PairLJKernelTest, ::testing::ValuesIn(kernels));
 }
 
 /* Run the actual test                  */
@@ -39,4 +272,4 @@ int main(int argc, char **argv){
   return RUN_ALL_TESTS();
 }
 
-  
+
@@ -5,10 +5,45 @@
  * @authors Maksim Markov <maxmarkov@gmail.com>, Manuel Proissl <mproissl@cern.ch>
  */
 #include "Atoms.h"
+#include "ClusterList.h"
+#include <algorithm>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
 
 static const double _def_ = -999;
 
 
+/* move an atom between cells of the given cell lists: the last atom of its
+   old cell takes its slot, the new cell grows if needed */
+static bool MoveInCells(std::vector<std::vector<int> > &cells, int *natoms_in_cell, int *atomcell,
+                        int idx, int cellID)
+{
+    int from, k, n;
+
+    from = atomcell[idx];
+    if(from == cellID) return true;
+
+    n = natoms_in_cell[from];
+    for(k=0; k<n; ++k) {
+        if(cells[from][k] == idx) break;
+    }
+    if(k == n) return false;
+    cells[from][k] = cells[from][n-1];
+    natoms_in_cell[from] = n-1;
+
+    n = natoms_in_cell[cellID];
+    if(n >= (int)cells[cellID].size()) {
+        cells[cellID].resize(2*cells[cellID].size() + 2);
+    }
+    cells[cellID][n] = idx;
+    natoms_in_cell[cellID] = n+1;
+    atomcell[idx] = cellID;
+    return true;
+}
+
+
 /**
  * Default constructor
  * ___________________________________________________________________________________
@@ -19,18 +54,60 @@ Atoms::Atoms() :
     m_mass(_def_),
     m_kinenergy(_def_),
     m_potenergy(_def_),
+    m_virial(_def_),
     m_position(NULL),
     m_velocity(NULL),
     m_force(NULL),
+    m_image(NULL),
     m_temperature(_def_),
+    m_pressure(_def_),
     m_radcut(_def_),
-    m_boxsize(_def_),
+    m_triclinic(false),
     m_npairs(0),
-    m_pairlist(NULL),
+    m_pairfirst(0),
+    m_pairpack(0),
+    m_activepairs(0),
+    m_activefirst(0),
+    m_cellbox(0),
+    m_nbrfirst(0),
+    m_nbrpack(0),
     m_ncells(0),
+    m_cellorder(0),
     m_natoms_in_cell(NULL),
-    m_cells(0, std::vector<int>(0))
-{};
+    m_cells(0, std::vector<int>(0)),
+    m_atomcell(NULL),
+    m_nextnatoms(0),
+    m_nextcells(0, std::vector<int>(0)),
+    m_nextatomcell(0),
+    m_nextactivepairs(0),
+    m_nextactivefirst(0),
+    m_nextnbrfirst(0),
+    m_nextnbrpack(0),
+    m_nextcell(NULL),
+    m_nextpos(NULL),
+    m_nextrlist(0.0),
+    m_nextpending(false),
+    m_nextbuilt(false),
+    m_nextfailed(false),
+    m_useghosts(false),
+    m_nghostcells(0),
+    m_nghosts(0),
+    m_maxghosts(0),
+    m_ghostowner(NULL),
+    m_ghostshift(NULL),
+    m_padpos(NULL),
+    m_padforce(NULL),
+    m_nghostpairs(0),
+    m_ghostpairlist(NULL),
+    m_clusters(NULL)
+{
+    for(int i=0; i<3; ++i) {
+        this->m_box[i] = _def_;
+        this->m_boxinv[i] = 1.0/_def_;
+        this->m_tilt[i] = 0.0;
+    }
+    for(int i=0; i<3*cellpair_nimages; ++i) this->m_imageshift[i] = 0.0;
+};
 
 
 /**
@@ -39,11 +116,17 @@ Atoms::Atoms() :
  */
 Atoms::~Atoms()
 {
-    if(this->m_position)       delete this->m_position;
-    if(this->m_velocity)       delete this->m_velocity;
-    if(this->m_force)          delete this->m_force;
-    if(this->m_pairlist)       delete this->m_pairlist;
-    if(this->m_natoms_in_cell) delete this->m_natoms_in_cell;
+    if(this->m_position)       delete [] this->m_position;
+    if(this->m_velocity)       delete [] this->m_velocity;
+    if(this->m_force)          delete [] this->m_force;
+    if(this->m_image)          delete [] this->m_image;
+    if(this->m_natoms_in_cell) delete [] this->m_natoms_in_cell;
+    if(this->m_atomcell)       delete [] this->m_atomcell;
+    if(this->m_ghostowner)     delete [] this->m_ghostowner;
+    if(this->m_ghostshift)     delete [] this->m_ghostshift;
+    if(this->m_padpos)         delete [] this->m_padpos;
+    if(this->m_padforce)       delete [] this->m_padforce;
+    if(this->m_ghostpairlist)  delete [] this->m_ghostpairlist;
 };
 
 
@@ -69,9 +152,17 @@ bool Atoms::Init(int natoms)
     }
 
     //Init position, velocity and force arrays
+    //(the force array holds one copy per thread for the reduction in Pair_LJ)
+    int nthreads = 1;
+#if defined(_OPENMP)
+    nthreads = omp_get_max_threads();
+#endif
     this->m_position = new double[3*natoms];
     this->m_velocity = new double[3*natoms];
-    this->m_force    = new double[3*natoms];
+    this->m_force    = new double[3*natoms*nthreads];
+    this->m_atomcell = new int[natoms];
+    this->m_image    = new int[3*natoms];
+    this->ClearImages();
 
     //No errors
     return true;
@@ -138,20 +229,166 @@ bool Atoms::SetForce(int idx, double force)
 };
 
 
+/**
+ * Reset periodic image counters
+ * ___________________________________________________________________________________
+ */
+void Atoms::ClearImages()
+{
+    for(int i=0; i<3*this->m_natoms; ++i) this->m_image[i] = 0;
+};
+
+
+/**
+ * Set box
+ * ___________________________________________________________________________________
+ */
+void Atoms::SetBoxSize(double lx, double ly, double lz, double xy, double xz, double yz)
+{
+    this->m_box[0] = lx;
+    this->m_box[1] = ly;
+    this->m_box[2] = lz;
+    this->m_tilt[0] = xy;
+    this->m_tilt[1] = xz;
+    this->m_tilt[2] = yz;
+    for(int i=0; i<3; ++i) this->m_boxinv[i] = 1.0/this->m_box[i];
+    this->m_triclinic = (xy != 0.0 || xz != 0.0 || yz != 0.0);
+
+    //Shift vectors of the image codes of cell pairs
+    for(int code=0; code<cellpair_nimages; ++code) {
+        double n[3];
+        n[0] = code/25 - 2;
+        n[1] = (code/5)%5 - 2;
+        n[2] = code%5 - 2;
+        this->FromFractional(n, this->m_imageshift + 3*code);
+    }
+};
+
+
+/**
+ * Get distance between opposite faces of the box
+ * ___________________________________________________________________________________
+ */
+double Atoms::GetBoxWidth(int dim)
+{
+    double lx=this->m_box[0], ly=this->m_box[1], lz=this->m_box[2];
+    double xy=this->m_tilt[0], xz=this->m_tilt[1], yz=this->m_tilt[2];
+
+    //Volume divided by the area of the face (b x c, a x c, a x b)
+    if(dim==0) return lx*ly*lz / sqrt(ly*ly*lz*lz + xy*xy*lz*lz + (xy*yz - ly*xz)*(xy*yz - ly*xz));
+    if(dim==1) return ly*lz / sqrt(lz*lz + yz*yz);
+    return lz;
+};
+
+
+/**
+ * Wrap the position of one atom into the box
+ * ___________________________________________________________________________________
+ */
+void Atoms::WrapPosition(int i)
+{
+    int n = this->m_natoms;
+    double s[3], d[3], *x = this->m_position;
+
+    this->ToFractional(x[i], x[n+i], x[2*n+i], s);
+    s[0] = rint(s[0]);
+    s[1] = rint(s[1]);
+    s[2] = rint(s[2]);
+    this->FromFractional(s, d);
+
+    x[i]     -= d[0];
+    x[n+i]   -= d[1];
+    x[2*n+i] -= d[2];
+    this->m_image[i]     += (int)s[0];
+    this->m_image[n+i]   += (int)s[1];
+    this->m_image[2*n+i] += (int)s[2];
+};
+
+
+/**
+ * Get the position of one atom wrapped into the box
+ * ___________________________________________________________________________________
+ */
+void Atoms::GetWrappedPosition(int i, double *r, int *s)
+{
+    int n = this->m_natoms;
+    double f[3], d[3], *x = this->m_position;
+
+    this->ToFractional(x[i], x[n+i], x[2*n+i], f);
+    f[0] = rint(f[0]);
+    f[1] = rint(f[1]);
+    f[2] = rint(f[2]);
+    this->FromFractional(f, d);
+
+    r[0] = x[i]     - d[0];
+    r[1] = x[n+i]   - d[1];
+    r[2] = x[2*n+i] - d[2];
+    s[0] = (int)f[0];
+    s[1] = (int)f[1];
+    s[2] = (int)f[2];
+};
+
+
+/**
+ * Shift the position of one atom by whole box vectors
+ * ___________________________________________________________________________________
+ */
+void Atoms::ShiftPosition(int i, const int *s)
+{
+    int n = this->m_natoms;
+    double f[3], d[3], *x = this->m_position;
+
+    f[0] = s[0];
+    f[1] = s[1];
+    f[2] = s[2];
+    this->FromFractional(f, d);
+
+    x[i]     -= d[0];
+    x[n+i]   -= d[1];
+    x[2*n+i] -= d[2];
+    this->m_image[i]     += s[0];
+    this->m_image[n+i]   += s[1];
+    this->m_image[2*n+i] += s[2];
+};
+
+
+/**
+ * Get shift of a coordinate by the wrapping into the box
+ * ___________________________________________________________________________________
+ */
+double Atoms::GetImageOffset(int idx)
+{
+    int n = this->m_natoms, i = idx % n, dim = idx / n;
+    const int *img = this->m_image;
+
+    //Image counters count box vectors a, b and c
+    if(dim==0) return img[i]*this->m_box[0] + img[n+i]*this->m_tilt[0] + img[2*n+i]*this->m_tilt[1];
+    if(dim==1) return img[n+i]*this->m_box[1] + img[2*n+i]*this->m_tilt[2];
+    return img[2*n+i]*this->m_box[2];
+};
+
+
 /**
  * Set number of cells (and setup cells and pairlist container)
  * ___________________________________________________________________________________
  */
 int Atoms::SetNCells(int ncells)
 {
-    //Set number of cells
+    //Set number of cells (any ghost layout or cluster list has to be set up again)
     this->m_ncells = ncells;
+    this->m_nghostcells = 0;
+    this->m_useghosts = false;
+    this->m_clusters = NULL;
+
+    //Cells are traversed in index order until an order is set
+    this->m_cellorder.resize(ncells);
+    for(int i=0; i<ncells; ++i) this->m_cellorder[i] = i;
 
     //Define cell data container ------>
     this->m_cells.clear();
     this->m_cells.resize(ncells);
     
-    if(this->m_natoms_in_cell) delete this->m_natoms_in_cell;
+    if(this->m_natoms_in_cell) delete [] this->m_natoms_in_cell;
     this->m_natoms_in_cell = new int[ncells];
     
     int nidx = 2 * this->m_natoms / ncells + 2;
@@ -161,29 +398,377 @@ int Atoms::SetNCells(int ncells)
         this->m_cells[i].resize(nidx);
     } //-------------------------------<
 
-    //Define pair list container
-    if(this->m_pairlist) delete this->m_pairlist;
-    this->m_pairlist = new int[2*ncells*ncells];
-
     //Index for Integrator class
     return nidx;
 };
 
 
 /**
- * Set item in pair list container
+ * Set number of pairs (and setup pairlist and shift container)
+ * ___________________________________________________________________________________
+ */
+bool Atoms::SetNPairs(int npairs)
+{
+    //Set number of pairs
+    this->m_npairs = npairs;
+
+    //Define pair list container (cells without pairs yet point past the end)
+    this->m_pairfirst.assign(this->m_ncells+1, npairs);
+    this->m_pairpack.resize(npairs);
+
+    //No pairs are active until they are pruned
+    this->m_activepairs.clear();
+    this->m_activefirst.assign(this->m_ncells+1, 0);
+
+    //No errors
+    return true;
+};
+
+
+/**
+ * Set traversal order of cells
+ * ___________________________________________________________________________________
+ */
+bool Atoms::SetCellOrder(const std::vector<int> &order)
+{
+    //Sanity check: a permutation of the cells
+    std::vector<bool> seen(this->m_ncells, false);
+    if((int)order.size() != this->m_ncells) {
+        std::cout << "( ERROR ) Atoms::SetCellOrder(): order has to list every cell. Abort!" << std::endl;
+        return false;
+    }
+    for(int k=0; k<this->m_ncells; ++k) {
+        if(order[k]<0 || order[k]>=this->m_ncells || seen[order[k]]) {
+            std::cout << "( ERROR ) Atoms::SetCellOrder(): order is not a permutation of the cells. Abort!" << std::endl;
+            return false;
+        }
+        seen[order[k]] = true;
+    }
+    this->m_cellorder = order;
+
+    //No errors
+    return true;
+};
+
+
+/**
+ * Prune cell pairs by the bounding boxes of their atoms
+ * ___________________________________________________________________________________
+ */
+bool Atoms::PruneCellPairs(double rlist)
+{
+    //Next cell lists handed over before are outdated now
+    this->DropNextCells();
+
+    this->PruneCells(this->m_cells, this->m_natoms_in_cell, this->m_position, rlist,
+                     this->m_activepairs, this->m_activefirst);
+    return this->BuildCellNeighbors();
+};
+
+
+/**
+ * Prune cell pairs of given cells into given active pair lists
+ * ___________________________________________________________________________________
+ */
+void Atoms::PruneCells(const std::vector<std::vector<int> > &cells, const int *natoms_in_cell,
+                       const double *pos, double rlist,
+                       std::vector<int> &activepairs, std::vector<int> &activefirst)
+{
+    int c, k, p, d, nactive;
+    double rlsq = rlist*rlist;
+
+    //Bounding box of the atoms of each cell (empty cells get an inverted box)
+    this->m_cellbox.resize(6*this->m_ncells);
+    for(c=0; c<this->m_ncells; ++c) {
+        double *bb = &this->m_cellbox[6*c];
+
+        for(d=0; d<3; ++d) {
+            bb[d] = HUGE_VAL;
+            bb[3+d] = -HUGE_VAL;
+        }
+        for(k=0; k<natoms_in_cell[c]; ++k) {
+            int i = cells[c][k];
+            for(d=0; d<3; ++d) {
+                double r = pos[d*this->m_natoms + i];
+                if(r < bb[d]) bb[d] = r;
+                if(r > bb[3+d]) bb[3+d] = r;
+            }
+        }
+    }
+
+    //Keep pairs of non-empty cells whose boxes, the first one shifted,
+    //are within the pair list cutoff. they are stored by first cell in
+    //traversal order.
+    activepairs.resize(this->m_npairs);
+    activefirst.resize(this->m_ncells+1);
+    nactive = 0;
+    for(k=0; k<this->m_ncells; ++k) {
+        c = this->m_cellorder[k];
+        activefirst[k] = nactive;
+        if(natoms_in_cell[c] == 0) continue;
+
+        for(p=this->m_pairfirst[c]; p<this->m_pairfirst[c+1]; ++p) {
+            const double *bi, *bj, *shift;
+            double rsq = 0.0;
+            int j = this->GetPairCell(p);
+
+            if(natoms_in_cell[j] == 0) continue;
+            bi = &this->m_cellbox[6*c];
+            bj = &this->m_cellbox[6*j];
+            shift = this->GetPairShift(p);
+            for(d=0; d<3; ++d) {
+                double gap = fmax(0.0, fmax(bi[d] - shift[d] - bj[3+d], bj[d] - bi[3+d] + shift[d]));
+                rsq += gap*gap;
+            }
+            if(rsq < rlsq) activepairs[nactive++] = p;
+        }
+    }
+    activefirst[this->m_ncells] = nactive;
+    activepairs.resize(nactive);
+};
+
+
+/**
+ * Build full neighbor cell list
+ * ___________________________________________________________________________________
+ */
+bool Atoms::BuildCellNeighbors()
+{
+    this->BuildNeighbors(this->m_activepairs, this->m_activefirst, this->m_nbrfirst, this->m_nbrpack);
+
+    //No errors
+    return true;
+};
+
+
+/**
+ * Build full neighbor cell list of given active pairs
+ * ___________________________________________________________________________________
+ */
+void Atoms::BuildNeighbors(const std::vector<int> &activepairs, const std::vector<int> &activefirst,
+                           std::vector<int> &nbrfirst, std::vector<unsigned int> &nbrpack)
+{
+    int a, c, k, p, *next;
+
+    //Count entries: the cell itself plus both cells of each active pair
+    nbrfirst.assign(this->m_ncells+1, 0);
+    for(k=0; k<this->m_ncells; ++k) {
+        c = this->m_cellorder[k];
+        nbrfirst[c+1] += 1 + activefirst[k+1] - activefirst[k];
+        for(a=activefirst[k]; a<activefirst[k+1]; ++a) {
+            ++nbrfirst[this->GetPairCell(activepairs[a])+1];
+        }
+    }
+    for(c=0; c<this->m_ncells; ++c) nbrfirst[c+1] += nbrfirst[c];
+
+    nbrpack.resize(nbrfirst[this->m_ncells]);
+    std::vector<int> fill(nbrfirst.begin(), nbrfirst.end()-1);
+    next = &fill[0];
+
+    //Cell itself first, then its pairs (seen from the second cell the
+    //shift is reversed, which mirrors the image code)
+    for(c=0; c<this->m_ncells; ++c) {
+        nbrpack[next[c]++] = ((unsigned int)c << cellpair_imagebits) | cellpair_noimage;
+    }
+    for(k=0; k<this->m_ncells; ++k) {
+        c = this->m_cellorder[k];
+        for(a=activefirst[k]; a<activefirst[k+1]; ++a) {
+            p = activepairs[a];
+
+            int j = this->GetPairCell(p);
+            int code = this->GetPairImage(p);
+
+            nbrpack[next[c]++] = ((unsigned int)j << cellpair_imagebits) | code;
+            nbrpack[next[j]++] = ((unsigned int)c << cellpair_imagebits) | (cellpair_nimages-1 - code);
+        }
+    }
+};
+
+
+/**
+ * Print memory footprint
+ * ___________________________________________________________________________________
+ */
+void Atoms::PrintMemory(FILE *fp)
+{
+    int nthreads = 1, nentries;
+    double mb, atoms, cells, pairs, active, nbrs, ghosts, clusters, total;
+    size_t c, nslots = 0;
+    char label[64];
+#if defined(_OPENMP)
+    nthreads = omp_get_max_threads();
+#endif
+    mb = 1.0/(1024.0*1024.0);
+    nentries = this->m_nbrpack.size();
+
+    //Positions, velocities, forces (one copy per thread), images and cell of each atom
+    atoms = (double)this->m_natoms * (3*sizeof(double)*(2 + nthreads) + 4*sizeof(int));
+    for(c=0; c<this->m_cells.size(); ++c) nslots += this->m_cells[c].capacity();
+    cells = nslots*sizeof(int) + this->m_cells.size()*(sizeof(std::vector<int>) + sizeof(int));
+    pairs = this->m_pairpack.capacity()*sizeof(unsigned int) + this->m_pairfirst.capacity()*sizeof(int);
+    active = (this->m_activepairs.capacity() + this->m_activefirst.capacity() + this->m_cellorder.capacity())*sizeof(int)
+        + this->m_cellbox.capacity()*sizeof(double);
+    nbrs  = this->m_nbrpack.capacity()*sizeof(unsigned int) + this->m_nbrfirst.capacity()*sizeof(int);
+    ghosts = 0.0;
+    if(this->m_maxghosts > 0) {
+        ghosts = this->m_maxghosts*(sizeof(int) + 3*sizeof(double))
+            + 3.0*sizeof(double)*(this->m_natoms + this->m_maxghosts)*(1 + nthreads)
+            + 2.0*sizeof(int)*this->m_nghostpairs;
+    }
+    clusters = this->m_clusters ? this->m_clusters->GetMemory() : 0.0;
+    total = atoms + cells + pairs + active + nbrs + ghosts + clusters;
+
+    fprintf(fp, "Memory footprint (MB):\n");
+    snprintf(label, sizeof(label), "atoms (%d, %d force copies)", this->m_natoms, nthreads);
+    fprintf(fp, "  %-36s %10.3f\n", label, atoms*mb);
+    snprintf(label, sizeof(label), "cell lists (%d cells)", (int)this->m_cells.size());
+    fprintf(fp, "  %-36s %10.3f\n", label, cells*mb);
+    snprintf(label, sizeof(label), "cell pairs (%d, packed)", this->m_npairs);
+    fprintf(fp, "  %-36s %10.3f   unpacked %10.3f\n", label, pairs*mb,
+            this->m_npairs*(2*sizeof(int) + 3*sizeof(double))*mb);
+    snprintf(label, sizeof(label), "active cell pairs (%d)", (int)this->m_activepairs.size());
+    fprintf(fp, "  %-36s %10.3f\n", label, active*mb);
+    snprintf(label, sizeof(label), "neighbor cells (%d, packed)", nentries);
+    fprintf(fp, "  %-36s %10.3f   unpacked %10.3f\n", label, nbrs*mb,
+            (nentries*(sizeof(int) + 3*sizeof(double)) + this->m_nbrfirst.size()*sizeof(int))*mb);
+    fprintf(fp, "  %-36s %10.3f\n", "ghost layout", ghosts*mb);
+    fprintf(fp, "  %-36s %10.3f\n", "cluster pairs", clusters*mb);
+    fprintf(fp, "  %-36s %10.3f\n", "total", total*mb);
+};
+
+
+/**
+ * Set number of ghost cells
+ * ___________________________________________________________________________________
+ */
+bool Atoms::SetNGhostCells(int nghostcells)
+{
+    int i, *natoms_in_cell;
+
+    //Ghost cells follow the cells of the box
+    this->m_nghostcells = nghostcells;
+    this->m_cells.resize(this->m_ncells + nghostcells);
+
+    natoms_in_cell = new int[this->m_ncells + nghostcells];
+    for(i=0; i<this->m_ncells; ++i) natoms_in_cell[i] = this->m_natoms_in_cell[i];
+    for(i=this->m_ncells; i<this->m_ncells + nghostcells; ++i) natoms_in_cell[i] = 0;
+    delete [] this->m_natoms_in_cell;
+    this->m_natoms_in_cell = natoms_in_cell;
+
+    //No errors
+    return true;
+};
+
+
+/**
+ * Set number of ghost atoms
  * ___________________________________________________________________________________
  */
-bool Atoms::SetPairItem(int idx, int pair)
+bool Atoms::SetNGhosts(int nghosts)
+{
+    this->m_nghosts = nghosts;
+    if(nghosts <= this->m_maxghosts) return true;
+
+    //Grow containers with some headroom, as ghost counts change with cell membership
+    int nthreads = 1;
+#if defined(_OPENMP)
+    nthreads = omp_get_max_threads();
+#endif
+    this->m_maxghosts = nghosts + nghosts/4 + 16;
+    if(this->m_ghostowner) delete [] this->m_ghostowner;
+    if(this->m_ghostshift) delete [] this->m_ghostshift;
+    if(this->m_padpos)     delete [] this->m_padpos;
+    if(this->m_padforce)   delete [] this->m_padforce;
+    this->m_ghostowner = new int[this->m_maxghosts];
+    this->m_ghostshift = new double[3*this->m_maxghosts];
+    this->m_padpos     = new double[3*(this->m_natoms + this->m_maxghosts)];
+    this->m_padforce   = new double[3*(this->m_natoms + this->m_maxghosts)*nthreads];
+
+    //No errors
+    return true;
+};
+
+
+/**
+ * Set ghost atom
+ * ___________________________________________________________________________________
+ */
+bool Atoms::SetGhost(int idx, int owner, double sx, double sy, double sz)
 {
     //Check index
-    if(idx<0 || idx>(2*this->m_ncells*this->m_ncells-1)) {
-        std::cout << "( ERROR ) Atoms::SetPairItem(): Index out-of-bound. Abort!" << std::endl;
+    if(idx<0 || idx>(this->m_nghosts-1)) {
+        std::cout << "( ERROR ) Atoms::SetGhost(): Index out-of-bound. Abort!" << std::endl;
         return false;
     }
 
-    //Set pair item
-    this->m_pairlist[idx] = pair;
+    this->m_ghostowner[idx] = owner;
+    this->m_ghostshift[3*idx]   = sx;
+    this->m_ghostshift[3*idx+1] = sy;
+    this->m_ghostshift[3*idx+2] = sz;
+
+    //No errors
+    return true;
+};
+
+
+/**
+ * Set number of pairs of the ghost layout
+ * ___________________________________________________________________________________
+ */
+bool Atoms::SetNGhostPairs(int npairs)
+{
+    this->m_nghostpairs = npairs;
+    if(this->m_ghostpairlist) delete [] this->m_ghostpairlist;
+    this->m_ghostpairlist = new int[2*npairs];
+    this->m_useghosts = true;
+
+    //No errors
+    return true;
+};
+
+
+/**
+ * Set item in ghost pair list container
+ * ___________________________________________________________________________________
+ */
+bool Atoms::SetGhostPairItem(int idx, int pair)
+{
+    //Check index
+    if(idx<0 || idx>(2*this->m_nghostpairs-1)) {
+        std::cout << "( ERROR ) Atoms::SetGhostPairItem(): Index out-of-bound. Abort!" << std::endl;
+        return false;
+    }
+
+    this->m_ghostpairlist[idx] = pair;
+
+    //No errors
+    return true;
+};
+
+
+/**
+ * Set cell pair
+ * ___________________________________________________________________________________
+ */
+bool Atoms::SetPair(int idx, int i, int j, int image)
+{
+    //Check index
+    if(idx<0 || idx>(this->m_npairs-1) || i<0 || i>=this->m_ncells || j<0 || j>=this->m_ncells) {
+        std::cout << "( ERROR ) Atoms::SetPair(): Index out-of-bound. Abort!" << std::endl;
+        return false;
+    }
+    if(image<0 || image>=cellpair_nimages || j >= (1 << (32-cellpair_imagebits))) {
+        std::cout << "( ERROR ) Atoms::SetPair(): image code or cell out of range of packed pairs. Abort!" << std::endl;
+        return false;
+    }
+    if(this->m_pairfirst[i+1] < idx) {
+        std::cout << "( ERROR ) Atoms::SetPair(): pairs have to be ordered by their first cell. Abort!" << std::endl;
+        return false;
+    }
+
+    //Set pair, first pair of this cell and of preceding cells without pairs
+    this->m_pairpack[idx] = ((unsigned int)j << cellpair_imagebits) | image;
+    for(int c=i; c>=0 && this->m_pairfirst[c]>idx; --c) this->m_pairfirst[c] = idx;
 
     //No errors
     return true;
@@ -201,10 +786,14 @@ bool Atoms::SetCellIndex(int cellID, int idxID, int idx)
         std::cout << "( ERROR ) Atoms::SetCellIndex(): cellID index out-of-bound. Abort!" << std::endl;
         return false;
     }
-    if(idxID>this->m_cells[cellID].size()) {
+    if(idxID<0) {
         std::cout << "( ERROR ) Atoms::SetCellIndex(): idxID index out-of-bound. Abort!" << std::endl;
         return false;
     }
+    if(idxID>=(int)this->m_cells[cellID].size()) {
+        //Grow cell container
+        this->m_cells[cellID].resize(2*idxID + 2);
+    }
 
     //Set cell data item
     this->m_cells[cellID][idxID] = idx;
@@ -234,6 +823,153 @@ bool Atoms::SetCellNAtoms(int cellID, int natoms)
 };
 
 
+/**
+ * Set cell of an atom
+ * ___________________________________________________________________________________
+ */
+bool Atoms::SetAtomCell(int idx, int cellID)
+{
+    //Sanity checks
+    if(idx<0 || idx>(this->m_natoms-1)) {
+        std::cout << "( ERROR ) Atoms::SetAtomCell(): Index out-of-bound. Abort!" << std::endl;
+        return false;
+    }
+
+    //Set cell
+    this->m_atomcell[idx] = cellID;
+
+    //No errors
+    return true;
+};
+
+
+/**
+ * Move an atom to another cell
+ * ___________________________________________________________________________________
+ */
+bool Atoms::MoveAtomCell(int idx, int cellID)
+{
+    //Sanity checks
+    if(idx<0 || idx>(this->m_natoms-1)) {
+        std::cout << "( ERROR ) Atoms::MoveAtomCell(): Index out-of-bound. Abort!" << std::endl;
+        return false;
+    }
+    if(cellID<0 || cellID>(this->m_ncells-1)) {
+        std::cout << "( ERROR ) Atoms::MoveAtomCell(): cellID index out-of-bound. Abort!" << std::endl;
+        return false;
+    }
+
+    if(!MoveInCells(this->m_cells, this->m_natoms_in_cell, this->m_atomcell, idx, cellID)) {
+        std::cout << "( ERROR ) Atoms::MoveAtomCell(): atom not found in its cell. Abort!" << std::endl;
+        return false;
+    }
+
+    //No errors
+    return true;
+};
+
+
+/**
+ * Hand over the cells of the atoms for the next cell lists
+ * ___________________________________________________________________________________
+ */
+bool Atoms::SetNextCells(const int *cell, const double *pos, double rlist)
+{
+    //Sanity check
+    if(this->m_useghosts || this->m_clusters) {
+        std::cout << "( ERROR ) Atoms::SetNextCells(): not available with ghost cells or clusters. Abort!" << std::endl;
+        return false;
+    }
+
+    this->m_nextcell = cell;
+    this->m_nextpos = pos;
+    this->m_nextrlist = rlist;
+    this->m_nextbuilt = false;
+    this->m_nextfailed = false;
+    this->m_nextpending = true;
+
+    //No errors
+    return true;
+};
+
+
+/**
+ * Build the next cell lists
+ * ___________________________________________________________________________________
+ */
+bool Atoms::BuildNextCells()
+{
+    int i;
+
+    //Start from the current cells and move the atoms that changed cell,
+    //as MoveAtomCell does for the current ones
+    this->m_nextcells = this->m_cells;
+    this->m_nextnatoms.assign(this->m_natoms_in_cell, this->m_natoms_in_cell + this->m_ncells);
+    this->m_nextatomcell.assign(this->m_atomcell, this->m_atomcell + this->m_natoms);
+    for(i=0; i<this->m_natoms; ++i) {
+        if(this->m_nextcell[i] == this->m_nextatomcell[i]) continue;
+        if(!MoveInCells(this->m_nextcells, &this->m_nextnatoms[0], &this->m_nextatomcell[0], i, this->m_nextcell[i])) {
+            std::cout << "( ERROR ) Atoms::BuildNextCells(): atom not found in its cell. Abort!" << std::endl;
+            this->m_nextfailed = true;
+            return false;
+        }
+    }
+
+    this->PruneCells(this->m_nextcells, &this->m_nextnatoms[0], this->m_nextpos, this->m_nextrlist,
+                     this->m_nextactivepairs, this->m_nextactivefirst);
+    this->BuildNeighbors(this->m_nextactivepairs, this->m_nextactivefirst, this->m_nextnbrfirst, this->m_nextnbrpack);
+    this->m_nextbuilt = true;
+
+    //No errors
+    return true;
+};
+
+
+/**
+ * Replace the cell lists by the next ones
+ * ___________________________________________________________________________________
+ */
+bool Atoms::SwapCells()
+{
+    //Sanity check
+    if(!this->m_nextpending) {
+        std::cout << "( ERROR ) Atoms::SwapCells(): no next cell lists handed over. Abort!" << std::endl;
+        return false;
+    }
+    if(this->m_nextfailed) {
+        std::cout << "( ERROR ) Atoms::SwapCells(): next cell lists could not be built. Abort!" << std::endl;
+        return false;
+    }
+    if(!this->m_nextbuilt && !this->BuildNextCells()) return false;
+
+    //Containers are swapped, the plain arrays copied
+    this->m_cells.swap(this->m_nextcells);
+    std::copy(this->m_nextnatoms.begin(), this->m_nextnatoms.end(), this->m_natoms_in_cell);
+    std::copy(this->m_nextatomcell.begin(), this->m_nextatomcell.end(), this->m_atomcell);
+    this->m_activepairs.swap(this->m_nextactivepairs);
+    this->m_activefirst.swap(this->m_nextactivefirst);
+    this->m_nbrfirst.swap(this->m_nextnbrfirst);
+    this->m_nbrpack.swap(this->m_nextnbrpack);
+    this->m_nextpending = false;
+    this->m_nextbuilt = false;
+
+    //No errors
+    return true;
+};
+
+
+/**
+ * Drop the next cell lists
+ * ___________________________________________________________________________________
+ */
+void Atoms::DropNextCells()
+{
+    this->m_nextpending = false;
+    this->m_nextbuilt = false;
+    this->m_nextfailed = false;
+};
+
+
 /* ######################################################################################################## */
 
 
@@ -286,18 +1022,18 @@ double Atoms::GetForce(int idx)
 
 
 /**
- * Get item in pair list container
+ * Get item in ghost pair list container
  * ___________________________________________________________________________________
  */
-int Atoms::GetPairItem(int idx)
+int Atoms::GetGhostPairItem(int idx)
 {
     //Check index
-    if(idx<0 || idx>(2*this->m_ncells*this->m_ncells-1)) {
-        std::cout << "( ERROR ) Atoms::GetPairItem(): Index out-of-bound. Abort!" << std::endl;
-        return false;
+    if(idx<0 || idx>(2*this->m_nghostpairs-1)) {
+        std::cout << "( ERROR ) Atoms::GetGhostPairItem(): Index out-of-bound. Abort!" << std::endl;
+        return -1;
     }
 
-    return this->m_pairlist[idx];
+    return this->m_ghostpairlist[idx];
 };
 
 
@@ -367,3 +1103,18 @@ int Atoms::GetCellNAtoms(int cellID)
     return this->m_natoms_in_cell[cellID];
 };
 
+
+/**
+ * Get cell of an atom
+ * ___________________________________________________________________________________
+ */
+int Atoms::GetAtomCell(int idx)
+{
+    //Sanity checks
+    if(idx<0 || idx>(this->m_natoms-1)) {
+        std::cout << "( ERROR ) Atoms::GetAtomCell(): Index out-of-bound. Abort!" << std::endl;
+        return -1;
+    }
+
+    return this->m_atomcell[idx];
+};
@@ -0,0 +1,203 @@
+/**
+ * ClusterList
+ *
+ * @short This class groups the atoms of each cell into clusters of a fixed size and lists the pairs of clusters whose bounding boxes are within the cutoff plus skin, so the force kernel can compute all interactions of a cluster pair at once with masked cutoffs instead of looping over irregular neighbor counts.
+ */
+
+#include "ClusterList.h"
+#include <algorithm>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+/* orders atom indices by one planar coordinate */
+struct CoordLess {
+    const double *r;
+    bool operator()(int a, int b) const { return r[a] < r[b]; }
+};
+
+/* squared distance of two bounding boxes, the first one shifted by -shift */
+static double BoxDistSq(const double *bi, const double *bj, const double *shift)
+{
+    double rsq = 0.0;
+
+    for (int d=0; d < 3; ++d) {
+        double gap = fmax(0.0, fmax(bi[d] - shift[d] - bj[3+d], bj[d] - bi[3+d] + shift[d]));
+        rsq += gap*gap;
+    }
+    return rsq;
+}
+
+
+/**
+ * Default constructor
+ */
+ClusterList::ClusterList() :
+    m_nclusters(0),
+    m_nbuild(0),
+    m_slotatom(0),
+    m_atomslot(0),
+    m_natoms(0),
+    m_bbox(0),
+    m_entries(0),
+    m_jlist(0),
+    m_pos(0),
+    m_force(0)
+{};
+
+/**
+ * Default destructor
+ */
+ClusterList::~ClusterList()
+{};
+
+/**
+ * Build clusters and cluster pair list
+ */
+bool ClusterList::Build(Atoms *atom, double rlist)
+{
+    int c, k, d, p, ncell, natoms, nslots, maxthreads;
+    double rlsq, *x;
+    const int *pairfirst;
+    const double zero[3] = {0.0, 0.0, 0.0};
+    std::vector<int> cellfirst, idx;
+
+    ncell = atom->GetNCells();
+    pairfirst = atom->GetPairFirst();
+    natoms = atom->GetNAtoms();
+    x = atom->GetPosition();
+    rlsq = rlist * rlist;
+
+    /* each cell is split into clusters of its own, the last one padded */
+    cellfirst.resize(ncell+1);
+    this->m_nclusters = 0;
+    for (c=0; c < ncell; ++c) {
+        cellfirst[c] = this->m_nclusters;
+        this->m_nclusters += (atom->GetCellNAtoms(c) + cluster_size-1) / cluster_size;
+    }
+    cellfirst[ncell] = this->m_nclusters;
+    nslots = this->m_nclusters * cluster_size;
+
+#if defined(_OPENMP)
+    maxthreads = omp_get_max_threads();
+#else
+    maxthreads = 1;
+#endif
+    this->m_slotatom.assign(nslots, -1);
+    this->m_atomslot.assign(natoms, -1);
+    this->m_natoms.assign(this->m_nclusters, 0);
+    this->m_bbox.resize(6*this->m_nclusters);
+    this->m_pos.assign(3*nslots, 0.0);
+    this->m_force.resize(3*maxthreads*nslots);
+
+    for (c=0; c < ncell; ++c) {
+        int n, dim;
+        double lo[3], hi[3];
+        CoordLess less;
+
+        n = atom->GetCellNAtoms(c);
+        if (n == 0) continue;
+        idx.resize(n);
+        for (d=0; d < 3; ++d) {
+            lo[d] = HUGE_VAL;
+            hi[d] = -HUGE_VAL;
+        }
+        for (k=0; k < n; ++k) {
+            idx[k] = atom->GetCellIndex(c,k);
+            for (d=0; d < 3; ++d) {
+                lo[d] = fmin(lo[d], x[d*natoms + idx[k]]);
+                hi[d] = fmax(hi[d], x[d*natoms + idx[k]]);
+            }
+        }
+
+        /* split along the longest extent, which keeps the clusters compact */
+        dim = 0;
+        for (d=1; d < 3; ++d) if (hi[d] - lo[d] > hi[dim] - lo[dim]) dim = d;
+        less.r = x + dim*natoms;
+        std::sort(idx.begin(), idx.end(), less);
+
+        for (k=0; k < n; ++k) {
+            int ci, s;
+            double *bb;
+
+            ci = cellfirst[c] + k / cluster_size;
+            s = ci*cluster_size + this->m_natoms[ci];
+            bb = &this->m_bbox[6*ci];
+            if (this->m_natoms[ci] == 0) {
+                for (d=0; d < 3; ++d) bb[d] = bb[3+d] = x[d*natoms + idx[k]];
+            }
+            for (d=0; d < 3; ++d) {
+                bb[d]   = fmin(bb[d],   x[d*natoms + idx[k]]);
+                bb[3+d] = fmax(bb[3+d], x[d*natoms + idx[k]]);
+            }
+            this->m_slotatom[s] = idx[k];
+            this->m_atomslot[idx[k]] = s;
+            ++this->m_natoms[ci];
+        }
+    }
+
+    /* cluster pairs of the cell itself and of its cell pairs, grouped by
+       i-cluster and periodic shift. the test on the bounding boxes with the
+       cutoff extended by the skin keeps the list valid until atoms have to
+       migrate between cells. */
+    this->m_entries.clear();
+    this->m_jlist.clear();
+    for (c=0; c < ncell; ++c) {
+        int ci;
+
+        for (ci=cellfirst[c]; ci < cellfirst[c+1]; ++ci) {
+            const double *bi = &this->m_bbox[6*ci];
+            std::vector<std::pair<int,int> > cand;
+            std::vector<const double *> shifts(1, zero);
+            unsigned int e;
+
+            for (k=ci; k < cellfirst[c+1]; ++k) {
+                if (BoxDistSq(bi, &this->m_bbox[6*k], zero) < rlsq) cand.push_back(std::make_pair(0, k));
+            }
+            for (p=pairfirst[c]; p < pairfirst[c+1]; ++p) {
+                int c2, id;
+                const double *sh = atom->GetPairShift(p);
+
+                for (id=0; id < (int)shifts.size(); ++id) {
+                    if (shifts[id][0] == sh[0] && shifts[id][1] == sh[1] && shifts[id][2] == sh[2]) break;
+                }
+                if (id == (int)shifts.size()) shifts.push_back(sh);
+
+                c2 = atom->GetPairCell(p);
+                for (k=cellfirst[c2]; k < cellfirst[c2+1]; ++k) {
+                    if (BoxDistSq(bi, &this->m_bbox[6*k], sh) < rlsq) cand.push_back(std::make_pair(id, k));
+                }
+            }
+            std::sort(cand.begin(), cand.end());
+
+            for (e=0; e < cand.size(); ++e) {
+                if (e == 0 || cand[e].first != cand[e-1].first) {
+                    ClusterEntry ent;
+                    ent.ci = ci;
+                    ent.jbeg = this->m_jlist.size();
+                    for (d=0; d < 3; ++d) ent.shift[d] = shifts[cand[e].first][d];
+                    this->m_entries.push_back(ent);
+                }
+                this->m_jlist.push_back(cand[e].second);
+                this->m_entries.back().jend = this->m_jlist.size();
+            }
+        }
+    }
+    ++this->m_nbuild;
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Memory footprint
+ */
+double ClusterList::GetMemory()
+{
+    return (this->m_slotatom.capacity() + this->m_atomslot.capacity() + this->m_natoms.capacity()
+            + this->m_jlist.capacity()) * sizeof(int)
+        + (this->m_bbox.capacity() + this->m_pos.capacity() + this->m_force.capacity()) * sizeof(double)
+        + this->m_entries.capacity() * sizeof(ClusterEntry);
+};
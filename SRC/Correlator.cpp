@@ -0,0 +1,228 @@
+/**
+ * Correlator
+ *
+ * @short This class provides a multiple-tau correlator (Ramirez, Sinha and Lee, J. Chem. Phys. 133, 154103 (2010)) for the mean-squared displacement of the unwrapped positions or the velocity autocorrelation. Each level keeps a short history of samples averaged over m^level steps, so memory grows with the logarithm of the longest lag only.
+ */
+
+#include "Correlator.h"
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+const int corr_p=16;                  /* lags (history length) per level */
+const int corr_m=2;                   /* samples averaged when passing on to the next level */
+
+
+/**
+ * Default constructor
+ */
+Correlator::Correlator() :
+    m_atom(NULL),
+    m_kind(MSD),
+    m_nvalues(0),
+    m_nlevels(0),
+    m_nsamples(0),
+    m_hist(0),
+    m_head(0),
+    m_nhist(0),
+    m_acc(0),
+    m_nacc(0),
+    m_sum(0),
+    m_count(0),
+    m_unwrapped(0)
+{};
+
+/**
+ * Default destructor
+ */
+Correlator::~Correlator()
+{};
+
+/**
+ * Init
+ */
+bool Correlator::Init(Atoms *atom, Kind kind, int nlevels)
+{
+    //Set pointers
+    if(!atom) {
+        std::cerr << "( ERROR ) Atoms null pointer... Abort Init!" << std::endl;
+        return false;
+    }
+    else this->m_atom = atom;
+
+    if (nlevels < 1) {
+        std::cout << "( ERROR ) Correlator::Init(): need at least one level. Abort!" << std::endl;
+        return false;
+    }
+
+    this->m_kind = kind;
+    this->m_nvalues = 3 * atom->GetNAtoms();
+    this->m_nlevels = nlevels;
+    if (kind == MSD) this->m_unwrapped.resize(this->m_nvalues);
+    this->Reset();
+
+    //No error
+    return true;
+};//Init
+
+
+/**
+ * Clear history and correlations
+ */
+void Correlator::Reset()
+{
+    /* the history of a level is allocated once the level gets its first sample */
+    this->m_hist.assign(this->m_nlevels, std::vector<double>());
+    this->m_acc.assign(this->m_nlevels, std::vector<double>());
+    this->m_head.assign(this->m_nlevels, corr_p-1);
+    this->m_nhist.assign(this->m_nlevels, 0);
+    this->m_nacc.assign(this->m_nlevels, 0);
+    this->m_sum.assign(this->m_nlevels*corr_p, 0.0);
+    this->m_count.assign(this->m_nlevels*corr_p, 0);
+    this->m_nsamples = 0;
+};
+
+
+/**
+ * Add a sample
+ */
+bool Correlator::Sample()
+{
+    int i, n;
+    n = this->m_nvalues;
+
+    if (this->m_kind == MSD) {
+        double *x = &this->m_unwrapped[0];
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+        for (i=0; i < n; ++i) x[i] = this->m_atom->GetUnwrappedPosition(i);
+        this->Push(0, x);
+    } else {
+        this->Push(0, this->m_atom->GetVelocity());
+    }
+    ++this->m_nsamples;
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Insert a sample into a level
+ */
+void Correlator::Push(int level, const double *v)
+{
+    int k, n, head, nlag, kmin, maxthreads;
+    double *hist, *acc;
+    bool msd;
+    std::vector<double> part;
+
+    if (level >= this->m_nlevels) return;
+
+    n = this->m_nvalues;
+    if (this->m_hist[level].empty()) {
+        this->m_hist[level].assign(corr_p*n, 0.0);
+        this->m_acc[level].assign(n, 0.0);
+    }
+    hist = &this->m_hist[level][0];
+    acc  = &this->m_acc[level][0];
+    msd  = (this->m_kind == MSD);
+
+    head = this->m_head[level] = (this->m_head[level] + 1) % corr_p;
+    if (this->m_nhist[level] < corr_p) ++this->m_nhist[level];
+    nlag = this->m_nhist[level];
+
+    /* lags below p/m are resolved more finely by the level below */
+    kmin = (level == 0) ? 0 : corr_p/corr_m;
+
+#if defined(_OPENMP)
+    maxthreads = omp_get_max_threads();
+#else
+    maxthreads = 1;
+#endif
+    part.assign(maxthreads*corr_p, 0.0);
+
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+    {
+        int i, j, tid, nthreads, chunk, fromidx, toidx;
+        double *cur;
+
+#if defined(_OPENMP)
+        nthreads=omp_get_num_threads();
+        tid=omp_get_thread_num();
+#else
+        nthreads=1;
+        tid=0;
+#endif
+        /* each thread works on a contiguous chunk of the values */
+        chunk = 1 + (n / nthreads);
+        fromidx = tid * chunk;
+        toidx = fromidx + chunk;
+        if (toidx > n) toidx = n;
+
+        cur = hist + head*n;
+        for (i=fromidx; i < toidx; ++i) {
+            cur[i] = v[i];
+            acc[i] += v[i];
+        }
+
+        for (j=kmin; j < nlag; ++j) {
+            const double *old = hist + ((head - j + corr_p) % corr_p)*n;
+            double s = 0.0;
+
+            if (msd) {
+                for (i=fromidx; i < toidx; ++i) {
+                    double d = cur[i] - old[i];
+                    s += d*d;
+                }
+            } else {
+                for (i=fromidx; i < toidx; ++i) s += cur[i]*old[i];
+            }
+            part[tid*corr_p + j] = s;
+        }
+    }
+
+    /* reduce in a fixed order, so results do not depend on thread timing */
+    for (k=kmin; k < nlag; ++k) {
+        double s = 0.0;
+        for (int t=0; t < maxthreads; ++t) s += part[t*corr_p + k];
+        this->m_sum[level*corr_p + k] += s;
+        ++this->m_count[level*corr_p + k];
+    }
+
+    /* pass the block average on to the next level */
+    if (++this->m_nacc[level] == corr_m) {
+        int i;
+
+        for (i=0; i < n; ++i) acc[i] *= 1.0/corr_m;
+        this->Push(level+1, acc);
+        for (i=0; i < n; ++i) acc[i] = 0.0;
+        this->m_nacc[level] = 0;
+    }
+};
+
+
+/**
+ * Lag in samples
+ */
+long Correlator::GetLag(int k)
+{
+    long lag = k % corr_p;
+    for (int l=0; l < k / corr_p; ++l) lag *= corr_m;
+    return lag;
+};
+
+
+/**
+ * Correlation at a lag
+ */
+double Correlator::GetValue(int k)
+{
+    if (this->m_count[k] == 0) return 0.0;
+    return this->m_sum[k] / this->m_count[k] / this->m_atom->GetNAtoms();
+};
@@ -0,0 +1,137 @@
+/**
+ * Ensemble
+ *
+ * @short This class runs many independent MD replicas in one process, scheduling whole replicas across threads
+ */
+
+#include "Ensemble.h"
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+
+/**
+ * Default constructor
+ */
+Ensemble::Ensemble() :
+    m_replicas(0)
+{};
+
+/**
+ * Default destructor
+ */
+Ensemble::~Ensemble()
+{
+    //Release memory
+    for (unsigned int i=0; i<m_replicas.size(); ++i) delete m_replicas[i];
+};
+
+
+/**
+ * Read a list of input decks
+ */
+bool Ensemble::ReadList(FILE *fp)
+{
+    char fname[BLEN];
+
+    while (!feof(fp)) {
+        FILE *deck;
+        MDParams params;
+        int c;
+
+        /* skip trailing empty lines without complaining about EOF */
+        while ((c=fgetc(fp)) != EOF && isspace(c)) ;
+        if (c == EOF) break;
+        ungetc(c, fp);
+
+        if (get_a_line(fp, fname)) return false;
+        if (fname[0] == '\0') continue;
+
+        deck = fopen(fname, "r");
+        if (!deck) {
+            std::cout << "( ERROR ) Ensemble::ReadList(): cannot open input deck " << fname << ". Abort!" << std::endl;
+            return false;
+        }
+        if (!MyMD::ReadInput(deck, &params)) {
+            std::cout << "( ERROR ) Ensemble::ReadList(): cannot parse input deck " << fname << ". Abort!" << std::endl;
+            fclose(deck);
+            return false;
+        }
+        fclose(deck);
+
+        if (!this->AddReplica(params)) return false;
+    }
+
+    if (this->m_replicas.empty()) {
+        std::cout << "( ERROR ) Ensemble::ReadList(): no input decks given. Abort!" << std::endl;
+        return false;
+    }
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Add a replica
+ */
+bool Ensemble::AddReplica(const MDParams &params)
+{
+    if (params.natoms <= 0) {
+        std::cout << "( ERROR ) Ensemble::AddReplica(): number of atoms is 0. Abort!" << std::endl;
+        return false;
+    }
+    this->m_replicas.push_back(new MyMD(params));
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Read restarts, open output files and compute initial forces
+ */
+bool Ensemble::Setup()
+{
+    for (unsigned int i=0; i<m_replicas.size(); ++i) {
+        MyMD *md = this->m_replicas[i];
+
+        if (!md->ReadRestart(md->params.restfile)) return false;
+
+        /* per replica energy and trajectory files, no screen output */
+        if (!md->OpenFiles(false)) return false;
+        if (!md->Setup()) return false;
+    }
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Run all replicas
+ */
+bool Ensemble::Run()
+{
+    int i, nrep;
+    nrep = this->m_replicas.size();
+
+#if defined(_OPENMP)
+    /* one thread per replica: the force kernel of a replica runs with a team of one */
+    omp_set_max_active_levels(1);
+#pragma omp parallel for schedule(dynamic,1)
+#endif
+    for (i=0; i < nrep; ++i) {
+        this->m_replicas[i]->MDLoop(false);
+    }
+
+    printf("   REPLICA      NFI            TEMP            EKIN                 EPOT              ETOT\n");
+    for (i=0; i < nrep; ++i) {
+        MDEnergies e = this->m_replicas[i]->GetEnergies();
+        printf("% 10d % 8d % 20.8f % 20.8f % 20.8f % 20.8f\n", i, e.nfi, e.temp, e.ekin, e.epot, e.etot);
+    }
+
+    //No error
+    return true;
+};
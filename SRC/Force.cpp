@@ -20,3 +20,17 @@ void Force::ComputeForce(Atoms *atom){
     pair->ComputeForce(atom);
   }
 }
+
+void Force::ComputeForce(Atoms *atom, int tid, int nthreads){
+  if(pot=="PAIR"){
+    pair->ComputeForce(atom, tid, nthreads);
+  }
+}
+
+double Force::ComputeAtomEnergy(Atoms *atom, int idx, double x, double y, double z,
+                                const std::vector<int> &cells){
+  if(pot=="PAIR"){
+    return pair->ComputeAtomEnergy(atom, idx, x, y, z, cells);
+  }
+  return 0.0;
+}
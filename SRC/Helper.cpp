@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <sys/time.h>
 #include "Helper.h"
 
 /**
@@ -61,16 +62,12 @@ void azzero(double *d, const int n)
 }
 
 /**
- * Apply minimum image convention
- * @param Double value
- * @param double matrix of box X 2
- * @param double value of box
- * @return The modified double which was given as the first parameter
+ * Wall clock time, also without OpenMP
+ * @return Seconds since the epoch
  */
-//__attribute__((always_inline,pure))
-double pbc(double x, const double boxby2, const double box)
+double wallclock()
 {
-    while (x >  boxby2) x -= box;
-    while (x < -boxby2) x += box;
-    return x;
+    struct timeval t;
+    gettimeofday(&t,0);
+    return ((double) t.tv_sec) + 1.0e-6*((double) t.tv_usec);
 }
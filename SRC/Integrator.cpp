@@ -6,11 +6,40 @@
  */
 
 #include "Integrator.h"
+#include "Helper.h"
+#include <map>
+#include <algorithm>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
 
 const double kboltz=0.0019872067;     /* boltzman constant in kcal/mol/K */
 const double mvsq2e=2390.05736153349; /* m*v^2 in kcal/mol */
+const double kcal2atm=68568.4150;     /* kcal/mol/A^3 in atm */
 const double cellrat=2.0;             /* ratio between cutoff radius and length of a cell */
-const int cellfreq=4;                 /* number of MD steps between cell list updates */
+const double cellskin=0.1;            /* cell pair list margin in units of the cell length */
+
+/* cell pair with the periodic image of its second cell, ordered like the pair list */
+struct CellPair {
+    int i, j, image;
+    bool operator<(const CellPair &o) const {
+        if (i != o.i) return i < o.i;
+        if (j != o.j) return j < o.j;
+        return image < o.image;
+    }
+};
+
+/* morton code of grid coordinates: their bits interleaved */
+static unsigned long MortonCode(const int *k)
+{
+    unsigned long code = 0;
+
+    for (int b=0; b < 21; ++b) {
+        for (int d=0; d < 3; ++d) code |= (unsigned long)((k[d] >> b) & 1) << (3*b + 2-d);
+    }
+    return code;
+}
 
 
 /**
@@ -20,9 +49,18 @@ Integrator::Integrator() :
     m_atom(NULL),
     m_force(NULL),
     m_timestep(0),
-    m_ngrid(0),
-    m_nidx(0),
-    m_delta(0)
+    m_xref(NULL),
+    m_xnext(NULL),
+    m_nmigrate(0),
+    m_part(0),
+    m_newcell(0),
+    m_wrap(0),
+    m_dlast(0),
+    m_ghost(false),
+    m_ghostsrc(0),
+    m_ghostshift(0),
+    m_cluster(false),
+    m_clusters(NULL)
 {};
 
 /**
@@ -33,6 +71,9 @@ Integrator::~Integrator()
     //Release memory
     if(m_atom)  delete m_atom;
     if(m_force) delete m_force;
+    if(m_xref)  delete [] m_xref;
+    if(m_xnext) delete [] m_xnext;
+    if(m_clusters) delete m_clusters;
 };
 
 /**
@@ -53,6 +94,14 @@ bool Integrator::Init(Atoms *atom, Force *force)
     }
     else this->m_force = force;
 
+    /* one partial result and last displacement per thread of a team */
+#if defined(_OPENMP)
+    this->m_part.assign(omp_get_max_threads(), 0.0);
+#else
+    this->m_part.assign(1, 0.0);
+#endif
+    this->m_dlast.assign(this->m_part.size(), 0.0);
+
     //No error
     return true;
 };//Init
@@ -63,18 +112,47 @@ bool Integrator::Init(Atoms *atom, Force *force)
  */
 bool Integrator::CalcKinEnergy() 
 {
-    int i=0;
+    return this->CalcKinEnergy(0, 1);
+};
+
+
+/**
+ * Calculate Kinetic Energy, share of one thread of a team
+ */
+bool Integrator::CalcKinEnergy(int tid, int nthreads)
+{
+    int i, chunk, fromidx, toidx, ndof;
     double ekin=0.0, temp=0.0;
 
-    for (i=0; i< (3 * this->m_atom->GetNAtoms()); ++i) {
+    /* each thread sums a contiguous chunk of the velocities */
+    ndof = 3 * this->m_atom->GetNAtoms();
+    chunk = 1 + (ndof / nthreads);
+    fromidx = tid * chunk;
+    toidx = fromidx + chunk;
+    if (toidx > ndof) toidx = ndof;
+
+    for (i=fromidx; i < toidx; ++i) {
         ekin += this->m_atom->GetVelocity(i) * this->m_atom->GetVelocity(i);
     }
+    this->m_part[tid] = ekin;
+    team_barrier(nthreads);
 
-    ekin *= 0.5 * mvsq2e * this->m_atom->GetMass();
-    this->m_atom->SetKinEnergy(ekin);
+    /* add up in a fixed order, so results do not depend on thread timing */
+    if (tid == 0) {
+        ekin = 0.0;
+        for (i=0; i < nthreads; ++i) ekin += this->m_part[i];
 
-    temp = 2.0 * ekin / (3.0 * this->m_atom->GetNAtoms() - 3.0) / kboltz;
-    this->m_atom->SetTemp(temp);
+        ekin *= 0.5 * mvsq2e * this->m_atom->GetMass();
+        this->m_atom->SetKinEnergy(ekin);
+
+        temp = 2.0 * ekin / (3.0 * this->m_atom->GetNAtoms() - 3.0) / kboltz;
+        this->m_atom->SetTemp(temp);
+
+        /* pressure from the kinetic term and the virial of the last force computation */
+        this->m_atom->SetPressure((this->m_atom->GetNAtoms() * kboltz * temp + this->m_atom->GetVirial() / 3.0)
+                                  / this->m_atom->GetVolume() * kcal2atm);
+    }
+    team_barrier(nthreads);
 
     //No error
     return true;
@@ -86,21 +164,42 @@ bool Integrator::CalcKinEnergy()
  */
 bool Integrator::CalcVelocity()
 {
-    int i;
+    return this->CalcVelocity(0, 1);
+};
+
+
+/**
+ * Calculate Velocity, share of one thread of a team
+ */
+bool Integrator::CalcVelocity(int tid, int nthreads)
+{
+    int i, chunk, fromidx, toidx, ndof;
     double dtmf;
     dtmf = 0.5 * this->m_timestep / mvsq2e / this->m_atom->GetMass();
 
+    /* each thread propagates a contiguous chunk of the coordinates */
+    ndof = 3 * this->m_atom->GetNAtoms();
+    chunk = 1 + (ndof / nthreads);
+    fromidx = tid * chunk;
+    toidx = fromidx + chunk;
+    if (toidx > ndof) toidx = ndof;
+
     /* first part: propagate velocities by half and positions by full step */
-    for (i=0; i< (3 * this->m_atom->GetNAtoms()); ++i) {
+    for (i=fromidx; i < toidx; ++i) {
       this->m_atom->SetVelocity(i, this->m_atom->GetVelocity(i)+dtmf * this->m_atom->GetForce(i));
       this->m_atom->SetPosition(i, this->m_atom->GetPosition(i)+ this->m_timestep * this->m_atom->GetVelocity(i));
     }
+    team_barrier(nthreads);
 
-    /* compute forces and potential energy */
-    this->m_force->ComputeForce(this->m_atom);
+    /* keep cell lists valid for the new positions */
+    this->MigrateAtoms(tid, nthreads);
+
+    /* compute forces and potential energy. the team is synchronized
+       once all forces are complete. */
+    this->m_force->ComputeForce(this->m_atom, tid, nthreads);
 
     /* second part: propagate velocities by another half step */
-    for (i=0; i< (3 * this->m_atom->GetNAtoms()); ++i) {
+    for (i=fromidx; i < toidx; ++i) {
       this->m_atom->SetVelocity(i, this->m_atom->GetVelocity(i)+dtmf * this->m_atom->GetForce(i));
     }
 
@@ -114,109 +213,467 @@ bool Integrator::CalcVelocity()
  */
 bool Integrator::UpdateCells()
 {
-    int i, ngrid, ncell, npair, midx, natoms;
-    double delta, boxby2, boxoffs;
-    boxby2 = 0.5 * this->m_atom->GetBoxSize();
+    int i, d, ncell, npair, midx, natoms;
+    double rcut;
     natoms = this->m_atom->GetNAtoms();
+
+    if (this->m_ghost && this->m_cluster) {
+        std::cout << "( ERROR ) Integrator::UpdateCells(): ghost layer and cluster pairs cannot be combined. Abort!" << std::endl;
+        return false;
+    }
         
-    if (this->m_atom->GetNCells()>=0) { //orig: sys->clist == NULL
-        int nidx;
-        
-        ngrid  = floor(cellrat * this->m_atom->GetBoxSize() / this->m_atom->GetRadCut());
-        ncell  = ngrid*ngrid*ngrid;
-        delta  = this->m_atom->GetBoxSize() / ngrid;
-        boxoffs= boxby2 - 0.5*delta;
-       
-        this->SetDelta(delta);
-        this->SetNGrid(ngrid);
+    /* the cell grid and pair list depend on box, cutoff and cell ratio only:
+       as long as these are unchanged, atoms just have to be re-binned */
+    if (!this->m_topo.Matches(this->m_atom, cellrat, this->m_ghost)) {
+        int nidx, ng[3], reach[3];
+        double cellwidth[3], rcell;
+
+        /* independent grid per dimension, from the distance of opposite box faces */
+        for (d=0; d < 3; ++d) {
+            double width = this->m_atom->GetBoxWidth(d);
+            if (this->m_atom->GetRadCut() >= 0.5*width) {
+                std::cout << "( ERROR ) Integrator::UpdateCells(): cutoff must be smaller than half the box width. Abort!" << std::endl;
+                return false;
+            }
+            ng[d] = floor(cellrat * width / this->m_atom->GetRadCut());
+            cellwidth[d] = width / ng[d];
+            this->m_topo.ngrid[d] = ng[d];
+            this->m_topo.delta[d] = this->m_atom->GetBoxSize(d) / ng[d];
+        }
+        ncell = ng[0]*ng[1]*ng[2];
+        this->m_topo.skin = cellskin * fmin(cellwidth[0], fmin(cellwidth[1], cellwidth[2]));
         nidx = this->m_atom->SetNCells(ncell); /* In addition, allocates cell list storage and
                                                  allocate index lists within cell. cell density < 2x avg. density */
-        this->m_nidx = nidx;
-
-        /* build cell pair list, assuming newtons 3rd law. */
-        npair = 0;
-        for (i=0; i < ncell-1; ++i) {
-            int j,k;
-            double x1,y1,z1;
-            
-            k  = i/ngrid/ngrid;
-            x1 = k*delta - boxoffs;
-            y1 = ((i-(k*ngrid*ngrid))/ngrid)*delta - boxoffs;
-            z1 = (i % ngrid)*delta - boxoffs;
-
-            for (j=i+1; j<ncell; ++j) {
-                double x2,y2,z2,rx,ry,rz;
-                
-                k  = j/ngrid/ngrid;
-                x2 = k*delta - boxoffs;
-                y2 = ((j-(k*ngrid*ngrid))/ngrid)*delta - boxoffs;
-                z2 = (j % ngrid)*delta - boxoffs;
-
-                rx=pbc(x1 - x2, boxby2, this->m_atom->GetBoxSize());
-                ry=pbc(y1 - y2, boxby2, this->m_atom->GetBoxSize());
-                rz=pbc(z1 - z2, boxby2, this->m_atom->GetBoxSize());
-
-                /* check for cells on a line that are too far apart */
-                if (fabs(rx) > this->m_atom->GetRadCut() + delta) continue;
-                if (fabs(ry) > this->m_atom->GetRadCut() + delta) continue;
-                if (fabs(rz) > this->m_atom->GetRadCut() + delta) continue;
-
-                /* check for cells in a plane that are too far apart */
-                if (sqrt(rx*rx+ry*ry) > (this->m_atom->GetRadCut() +sqrt(2.0)*delta)) continue;
-                if (sqrt(rx*rx+rz*rz) > (this->m_atom->GetRadCut() +sqrt(2.0)*delta)) continue;
-                if (sqrt(ry*ry+rz*rz) > (this->m_atom->GetRadCut() +sqrt(2.0)*delta)) continue;
-
-                /* other cells that are too far apart */
-                if (sqrt(rx*rx + ry*ry + rz*rz) > (sqrt(3.0) * delta + this->m_atom->GetRadCut())) continue;
-                
+        this->m_topo.nidx = nidx;
+
+        /* the force kernels traverse the cells along the morton curve, so
+           cells (and their pairs) that follow each other are close in space
+           and contiguous chunks of cells are compact regions */
+        std::vector<std::pair<unsigned long,int> > morton(ncell);
+        std::vector<int> order(ncell), rank(ncell);
+        for (i=0; i < ncell; ++i) {
+            int k[3];
+
+            k[0] = i/(ng[1]*ng[2]);
+            k[1] = (i/ng[2]) % ng[1];
+            k[2] = i % ng[2];
+            morton[i] = std::make_pair(MortonCode(k), i);
+        }
+        std::sort(morton.begin(), morton.end());
+        for (i=0; i < ncell; ++i) {
+            order[i] = morton[i].second;
+            rank[order[i]] = i;
+        }
+        if (!this->m_atom->SetCellOrder(order)) return false;
+
+        /* atoms of a cell are at most half the longest cell diagonal from its center */
+        rcell = 0.0;
+        for (i=0; i < 4; ++i) {
+            double sd[3], e[3];
+            sd[0] = 0.5/ng[0];
+            sd[1] = ((i & 1) ? -0.5 : 0.5)/ng[1];
+            sd[2] = ((i & 2) ? -0.5 : 0.5)/ng[2];
+            this->m_atom->FromFractional(sd, e);
+            rcell = fmax(rcell, sqrt(e[0]*e[0] + e[1]*e[1] + e[2]*e[2]));
+        }
+
+        /* build cell pair list, assuming newtons 3rd law: each pair is
+           listed with the cell that comes first along the curve, so the
+           pairs of a cell reach ahead of it in traversal order. the cutoff is
+           extended by the skin, so atoms may stray from their cell by half
+           the skin before they have to be migrated. each pair stores the
+           periodic shift of its second cell; when several images of a cell
+           are close enough (small boxes), each gets its own entry. with
+           rcut < box width/2 at most one of them has atoms within the cutoff.
+           neighbors are searched over the offsets that can be in reach. */
+        rcut = this->m_atom->GetRadCut() + this->m_topo.skin;
+        for (d=0; d < 3; ++d) reach[d] = floor((rcut + 2.0*rcell)/cellwidth[d]) + 1;
+
+        std::vector<CellPair> pairs;
+        for (i=0; i < ncell; ++i) {
+            int k[3], o[3];
+
+            k[0] = i/(ng[1]*ng[2]);
+            k[1] = (i/ng[2]) % ng[1];
+            k[2] = i % ng[2];
+
+            for (o[0]=-reach[0]; o[0] <= reach[0]; ++o[0]) {
+            for (o[1]=-reach[1]; o[1] <= reach[1]; ++o[1]) {
+            for (o[2]=-reach[2]; o[2] <= reach[2]; ++o[2]) {
+                CellPair p;
+                int j, n[3], kj[3];
+                double so[3], r[3];
+
+                /* neighbor cell in the box and the periodic image it is used in */
+                for (d=0; d < 3; ++d) {
+                    kj[d] = k[d] + o[d];
+                    n[d]  = (kj[d] >= 0) ? kj[d]/ng[d] : -((ng[d]-1-kj[d])/ng[d]);
+                    kj[d] -= n[d]*ng[d];
+                }
+                j = (kj[0]*ng[1] + kj[1])*ng[2] + kj[2];
+                if (j == i || rank[j] < rank[i]) continue;
+
+                /* distance of the cell centers */
+                for (d=0; d < 3; ++d) so[d] = -(double)o[d]/ng[d];
+                this->m_atom->FromFractional(so, r);
+
+                if (this->m_atom->IsTriclinic()) {
+                    /* conservative test for tilted cells */
+                    if (sqrt(r[0]*r[0] + r[1]*r[1] + r[2]*r[2]) > rcut + 2.0*rcell) continue;
+                } else {
+                    double *dl = this->m_topo.delta;
+
+                    /* check for cells on a line that are too far apart */
+                    if (fabs(r[0]) > rcut + dl[0]) continue;
+                    if (fabs(r[1]) > rcut + dl[1]) continue;
+                    if (fabs(r[2]) > rcut + dl[2]) continue;
+
+                    /* check for cells in a plane that are too far apart */
+                    if (sqrt(r[0]*r[0]+r[1]*r[1]) > (rcut + sqrt(dl[0]*dl[0]+dl[1]*dl[1]))) continue;
+                    if (sqrt(r[0]*r[0]+r[2]*r[2]) > (rcut + sqrt(dl[0]*dl[0]+dl[2]*dl[2]))) continue;
+                    if (sqrt(r[1]*r[1]+r[2]*r[2]) > (rcut + sqrt(dl[1]*dl[1]+dl[2]*dl[2]))) continue;
+
+                    /* other cells that are too far apart */
+                    if (sqrt(r[0]*r[0] + r[1]*r[1] + r[2]*r[2])
+                        > (sqrt(dl[0]*dl[0] + dl[1]*dl[1] + dl[2]*dl[2]) + rcut)) continue;
+                }
+
                 /* cells are close enough. add to list */
-                this->m_atom->SetPairItem(2*npair,   i);
-                this->m_atom->SetPairItem(2*npair+1, j);
-                ++npair;
+                p.i = i;
+                p.j = j;
+                p.image = ((n[0]+2)*5 + n[1]+2)*5 + n[2]+2;
+                pairs.push_back(p);
+            }
+            }
             }
         }
+        std::sort(pairs.begin(), pairs.end());
+
+        npair = pairs.size();
         this->m_atom->SetNPairs(npair);
+        for (i=0; i < npair; ++i) {
+            if (!this->m_atom->SetPair(i, pairs[i].i, pairs[i].j, pairs[i].image)) return false;
+        }
+
+        if (this->m_ghost) this->BuildGhostLayout();
         
-	// printf("Cell list has %dx%dx%d=%d cells with %d/%d pairs and "
-	//      "%d atoms/celllist.\n", ngrid, ngrid, ngrid, this->m_atom->GetNCells(), 
-        //       this->m_atom->GetNPairs(), ncell*(ncell-1)/2, nidx);
+	// printf("Cell list has %dx%dx%d=%d cells with %d pairs and "
+	//      "%d atoms/celllist.\n", ng[0], ng[1], ng[2], this->m_atom->GetNCells(),
+        //       this->m_atom->GetNPairs(), nidx);
+
+        this->m_topo.SetKey(this->m_atom, cellrat, this->m_ghost);
     }
 
     /* reset cell list and sort atoms into cells */
+    this->WrapPositions();
     ncell = this->m_atom->GetNCells();
-    delta = this->GetDelta();
-    ngrid = this->GetNGrid();
-    
+
     for (i=0; i < ncell; ++i) {
         this->m_atom->SetCellNAtoms(i,0);
     }
 
-    boxoffs= boxby2 - 0.5*delta;
     midx=0;
     for (i=0; i < natoms; ++i) {
-        int idx,j,k,m,n;
-        
-        k=floor((pbc(this->m_atom->GetPosition(i),            
-		     boxby2, this->m_atom->GetBoxSize())+boxby2)/delta);
-        m=floor((pbc(this->m_atom->GetPosition(natoms + i),   
-		     boxby2, this->m_atom->GetBoxSize())+boxby2)/delta);
-        n=floor((pbc(this->m_atom->GetPosition(2*natoms + i), 
-		     boxby2, this->m_atom->GetBoxSize())+boxby2)/delta);
-        j = ngrid*ngrid*k+ngrid*m+n;
+        int idx,j;
+
+        j = this->CellIndex(this->m_atom->GetPosition(i),
+                            this->m_atom->GetPosition(natoms + i),
+                            this->m_atom->GetPosition(2*natoms + i));
 
         idx = this->m_atom->GetCellNAtoms(j);
         this->m_atom->SetCellIndex(j,idx,i);
+        this->m_atom->SetAtomCell(i,j);
         ++idx;
         this->m_atom->SetCellNAtoms(j,idx);
         if (idx > midx) midx=idx;
     }
-    if (midx > this->m_nidx) {
-        printf("overflow in cell list: %d/%d atoms/cells.\n", midx, this->m_nidx);
+    if (midx > this->m_topo.nidx) {
+        printf("overflow in cell list: %d/%d atoms/cells.\n", midx, this->m_topo.nidx);
         exit(1);
     }
 
+    /* drop cell pairs whose atoms are out of reach until the next migration */
+    if (!this->m_atom->PruneCellPairs(this->m_atom->GetRadCut() + this->m_topo.skin)) return false;
+    if (this->m_ghost) this->UpdateGhosts();
+    if (this->m_cluster) this->BuildClusters();
+    else this->m_atom->SetClusters(NULL);
+
+    /* reference for the displacement check in MigrateAtoms */
+    if (!this->m_xref) this->m_xref = new double[3*natoms];
+    if (!this->m_xnext) this->m_xnext = new double[3*natoms];
+    this->m_newcell.resize(natoms);
+    this->m_wrap.resize(3*natoms);
+    for (i=0; i < 3*natoms; ++i) this->m_xref[i] = this->m_atom->GetPosition(i);
+    for (i=0; i < (int)this->m_dlast.size(); ++i) this->m_dlast[i] = 0.0;
+
     //No error
     return true;
 };
 
 
+/**
+ * Migrate atoms between cells
+ */
+bool Integrator::MigrateAtoms()
+{
+    return this->MigrateAtoms(0, 1);
+};
+
+
+/**
+ * Migrate atoms between cells, share of one thread of a team
+ */
+bool Integrator::MigrateAtoms(int tid, int nthreads)
+{
+    int i, chunk, fromidx, toidx, natoms;
+    double *x, dmax, dnext, limit;
+    bool ok = true;
+
+    if (!this->m_xref) {
+        if (tid == 0) ok = this->UpdateCells();
+        team_barrier(nthreads);
+        return ok;
+    }
+
+    natoms = this->m_atom->GetNAtoms();
+    x = this->m_atom->GetPosition();
+    chunk = 1 + (natoms / nthreads);
+    fromidx = tid * chunk;
+    toidx = fromidx + chunk;
+    if (toidx > natoms) toidx = natoms;
+
+    /* cell lists built ahead during the last force computation take over.
+       atoms are wrapped as they were when sorted into their new cells, and
+       the positions the lists were built from become the reference. if
+       they could not be built, they are dropped: the current cell lists and
+       reference stay, and the displacement check below migrates atoms once
+       that is due. */
+    if (this->m_atom->NextCellsPending()) {
+        bool built = !this->m_atom->NextCellsFailed();
+
+        for (i=fromidx; built && i < toidx; ++i) {
+            const int *s = &this->m_wrap[3*i];
+            if (s[0] || s[1] || s[2]) this->m_atom->ShiftPosition(i, s);
+        }
+        team_barrier(nthreads);
+        if (tid == 0 && built) {
+            double *tmp = this->m_xref;
+            this->m_xref = this->m_xnext;
+            this->m_xnext = tmp;
+            ok = this->m_atom->SwapCells();
+            ++this->m_nmigrate;
+        } else if (tid == 0) {
+            std::cout << "( ERROR ) Integrator::MigrateAtoms(): next cell lists could not be built. Abort!" << std::endl;
+            this->m_atom->DropNextCells();
+            ok = false;
+        }
+        if (built) this->m_dlast[tid] = 0.0;
+        team_barrier(nthreads);
+    }
+
+    /* largest displacement since the last update: each thread checks its
+       atoms, then all of them take the maximum and come to the same decision */
+    dmax = 0.0;
+    for (i=fromidx; i < toidx; ++i) {
+        double dx = x[i]          - this->m_xref[i];
+        double dy = x[natoms+i]   - this->m_xref[natoms+i];
+        double dz = x[2*natoms+i] - this->m_xref[2*natoms+i];
+        double dsq = dx*dx + dy*dy + dz*dz;
+        if (dsq > dmax) dmax = dsq;
+    }
+    this->m_part[tid] = dmax;
+    team_barrier(nthreads);
+    for (i=0; i < nthreads; ++i) dmax = fmax(dmax, this->m_part[i]);
+    limit = 0.5 * this->m_topo.skin;
+
+    if (dmax <= limit*limit) {
+        /* the cell lists hold for this step. if the displacement, extrapolated
+           by one step, exceeds the limit at the next one, a team sets up the
+           next cell lists from the current positions, and one of its threads
+           builds them while the others compute the forces. */
+        dmax = sqrt(dmax);
+        dnext = 2.0*dmax - this->m_dlast[tid];
+        this->m_dlast[tid] = dmax;
+        if (nthreads < 2 || dnext <= limit || this->m_ghost || this->m_cluster) return true;
+
+        for (i=fromidx; i < toidx; ++i) {
+            double r[3];
+
+            this->m_atom->GetWrappedPosition(i, r, &this->m_wrap[3*i]);
+            this->m_xnext[i]          = r[0];
+            this->m_xnext[natoms+i]   = r[1];
+            this->m_xnext[2*natoms+i] = r[2];
+            this->m_newcell[i] = this->CellIndex(r[0], r[1], r[2]);
+        }
+        team_barrier(nthreads);
+        if (tid == 0) {
+            ok = this->m_atom->SetNextCells(&this->m_newcell[0], this->m_xnext,
+                                            this->m_atom->GetRadCut() + this->m_topo.skin);
+        }
+        team_barrier(nthreads);
+        return ok;
+    }
+
+    /* wrap positions and find the cells of the atoms. only atoms that
+       crossed a cell boundary are moved, by the first thread. */
+    for (i=fromidx; i < toidx; ++i) {
+        this->m_atom->WrapPosition(i);
+        this->m_newcell[i] = this->CellIndex(x[i], x[natoms+i], x[2*natoms+i]);
+    }
+    team_barrier(nthreads);
+    if (tid == 0) {
+        for (i=0; i < natoms; ++i) {
+            if (this->m_newcell[i] != this->m_atom->GetAtomCell(i)) this->m_atom->MoveAtomCell(i, this->m_newcell[i]);
+        }
+        ok = this->m_atom->PruneCellPairs(this->m_atom->GetRadCut() + this->m_topo.skin);
+        if (ok && this->m_ghost) this->UpdateGhosts();
+        if (ok && this->m_cluster) this->BuildClusters();
+        ++this->m_nmigrate;
+    }
+    for (i=fromidx; i < toidx; ++i) {
+        this->m_xref[i]          = x[i];
+        this->m_xref[natoms+i]   = x[natoms+i];
+        this->m_xref[2*natoms+i] = x[2*natoms+i];
+    }
+    this->m_dlast[tid] = 0.0;
+    team_barrier(nthreads);
+
+    return ok;
+};
+
+
+/**
+ * Build ghost cells and the ghost pair list
+ */
+bool Integrator::BuildGhostLayout()
+{
+    int c, i, ncell, npair;
+    const int *first;
+    std::map<std::pair<int,int>, int> ghostid;
+
+    ncell = this->m_atom->GetNCells();
+    npair = this->m_atom->GetNPairs();
+    first = this->m_atom->GetPairFirst();
+    this->m_ghostsrc.clear();
+    this->m_ghostshift.clear();
+
+    /* every cell used with a periodic shift becomes a ghost cell (once per
+       shift), so the pair list of the ghost layout needs no shifts */
+    this->m_atom->SetNGhostPairs(npair);
+    for (c=0; c < ncell; ++c) {
+        for (i=first[c]; i < first[c+1]; ++i) {
+            int j, code;
+            j = this->m_atom->GetPairCell(i);
+            code = this->m_atom->GetPairImage(i);
+
+            this->m_atom->SetGhostPairItem(2*i, c);
+            if (code == cellpair_noimage) {
+                this->m_atom->SetGhostPairItem(2*i+1, j);
+            } else {
+                std::pair<int,int> key(j, code);
+                if (ghostid.find(key) == ghostid.end()) {
+                    const double *shift = this->m_atom->GetImageShift(code);
+                    ghostid[key] = this->m_ghostsrc.size();
+                    this->m_ghostsrc.push_back(j);
+                    this->m_ghostshift.push_back(shift[0]);
+                    this->m_ghostshift.push_back(shift[1]);
+                    this->m_ghostshift.push_back(shift[2]);
+                }
+                this->m_atom->SetGhostPairItem(2*i+1, ncell + ghostid[key]);
+            }
+        }
+    }
+    this->m_atom->SetNGhostCells(this->m_ghostsrc.size());
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Fill ghost cells
+ */
+bool Integrator::UpdateGhosts()
+{
+    int g, k, ncell, natoms, nghostcells, nghosts;
+
+    ncell  = this->m_atom->GetNCells();
+    natoms = this->m_atom->GetNAtoms();
+    nghostcells = this->m_ghostsrc.size();
+
+    nghosts = 0;
+    for (g=0; g < nghostcells; ++g) nghosts += this->m_atom->GetCellNAtoms(this->m_ghostsrc[g]);
+    this->m_atom->SetNGhosts(nghosts);
+
+    /* ghost atoms are numbered after the atoms in the padded arrays */
+    nghosts = 0;
+    for (g=0; g < nghostcells; ++g) {
+        int src = this->m_ghostsrc[g];
+        int n = this->m_atom->GetCellNAtoms(src);
+
+        for (k=0; k < n; ++k) {
+            this->m_atom->SetGhost(nghosts, this->m_atom->GetCellIndex(src,k), this->m_ghostshift[3*g],
+                                   this->m_ghostshift[3*g+1], this->m_ghostshift[3*g+2]);
+            this->m_atom->SetCellIndex(ncell+g, k, natoms+nghosts);
+            ++nghosts;
+        }
+        this->m_atom->SetCellNAtoms(ncell+g, n);
+    }
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Build clusters and cluster pair list
+ */
+bool Integrator::BuildClusters()
+{
+    if (!this->m_clusters) this->m_clusters = new ClusterList();
+
+    /* the list is rebuilt whenever atoms migrate, so the same skin as for
+       the cell pairs keeps it valid in between */
+    if (!this->m_clusters->Build(this->m_atom, this->m_atom->GetRadCut() + this->m_topo.skin)) return false;
+    this->m_atom->SetClusters(this->m_clusters);
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Wrap positions into the box
+ */
+bool Integrator::WrapPositions()
+{
+    for (int i=0; i < this->m_atom->GetNAtoms(); ++i) {
+        this->m_atom->WrapPosition(i);
+    }
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Cell of a position
+ */
+int Integrator::CellIndex(double x, double y, double z)
+{
+    int d, k[3];
+    double s[3];
+
+    /* fractional coordinates, wrapped into the box */
+    this->m_atom->ToFractional(x, y, z, s);
+    for (d=0; d < 3; ++d) {
+        s[d] -= rint(s[d]);
+        k[d] = floor((s[d] + 0.5)*this->m_topo.ngrid[d]);
+
+        /* a coordinate exactly at the upper face belongs to the last cell */
+        if (k[d] >= this->m_topo.ngrid[d]) k[d] = this->m_topo.ngrid[d]-1;
+        if (k[d] < 0) k[d] = 0;
+    }
+
+    return (k[0]*this->m_topo.ngrid[1] + k[1])*this->m_topo.ngrid[2] + k[2];
+};
@@ -0,0 +1,403 @@
+/**
+ * Minimizer
+ *
+ * @short This class provides energy minimization (FIRE and Polak-Ribiere conjugate gradient) of the MD system, reusing the force and cell list machinery of the integrator.
+ */
+
+#include "Minimizer.h"
+#include "Helper.h"
+
+const double mvsq2e=2390.05736153349; /* m*v^2 in kcal/mol */
+
+/* FIRE parameters (Bitzek et al., PRL 97, 170201 (2006)) */
+const int    fire_nmin=5;             /* downhill steps before the time step may grow */
+const double fire_finc=1.1;           /* time step increase factor */
+const double fire_fdec=0.5;           /* time step decrease factor */
+const double fire_alpha0=0.1;         /* initial velocity mixing parameter */
+const double fire_falpha=0.99;        /* mixing parameter decrease factor */
+const double fire_dtmax=10.0;         /* largest time step in units of the initial one */
+
+/* line search parameters */
+const double ls_armijo=1.0e-4;        /* sufficient decrease constant */
+const int    ls_maxiter=20;           /* max number of backtracking steps */
+
+
+/**
+ * Default constructor
+ */
+Minimizer::Minimizer() :
+    m_atom(NULL),
+    m_force(NULL),
+    m_integrator(NULL),
+    m_style(FIRE),
+    m_ftol(1.0e-3),
+    m_etol(1.0e-10),
+    m_maxstep(0.1),
+    m_timestep(1.0),
+    m_dt(0),
+    m_alpha(0),
+    m_npos(0),
+    m_epot(0),
+    m_epotold(0),
+    m_fmax(0),
+    m_fsq(0),
+    m_lsalpha(0),
+    m_nfeval(0),
+    m_converged(false),
+    m_stopped(false),
+    m_stopreason(""),
+    m_dir(NULL),
+    m_fold(NULL),
+    m_xold(NULL)
+{};
+
+/**
+ * Default destructor
+ */
+Minimizer::~Minimizer()
+{
+    //Atoms and forces are owned by the integrator
+    if(m_dir)  delete [] m_dir;
+    if(m_fold) delete [] m_fold;
+    if(m_xold) delete [] m_xold;
+};
+
+/**
+ * Init
+ */
+bool Minimizer::Init(Atoms *atom, Force *force, Integrator *integrator)
+{
+    //Set pointers
+    if(!atom) {
+        std::cerr << "( ERROR ) Atoms null pointer... Abort Init!" << std::endl;
+        return false;
+    }
+    else this->m_atom = atom;
+
+    if(!force) {
+        std::cerr << "( ERROR ) Force null pointer... Abort Init!" << std::endl;
+        return false;
+    }
+    else this->m_force = force;
+
+    if(!integrator) {
+        std::cerr << "( ERROR ) Integrator null pointer... Abort Init!" << std::endl;
+        return false;
+    }
+    else this->m_integrator = integrator;
+
+    //No error
+    return true;
+};//Init
+
+
+/**
+ * Set minimization style by name
+ */
+bool Minimizer::SetStyle(std::string style)
+{
+    if(style=="fire")    this->m_style = FIRE;
+    else if(style=="cg") this->m_style = CG;
+    else {
+        std::cout << "( ERROR ) Minimizer::SetStyle(): unknown style '" << style << "'. Abort!" << std::endl;
+        return false;
+    }
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Prepare a minimization run
+ */
+bool Minimizer::Setup()
+{
+    int i, n3;
+    n3 = 3 * this->m_atom->GetNAtoms();
+
+    //Work arrays
+    if(this->m_dir || this->m_fold || this->m_xold) {
+        std::cout << "( ERROR ) Minimizer::Setup(): Bug hint > work arrays already defined. Abort!" << std::endl;
+        return false;
+    }
+    this->m_dir  = new double[n3];
+    this->m_fold = new double[n3];
+    this->m_xold = new double[n3];
+
+    //Initial forces and energy
+    this->m_integrator->UpdateCells();
+    this->m_nfeval = 0;
+    this->m_epot = this->m_epotold = this->EvalForce();
+    this->m_fmax = this->MaxForce(&this->m_fsq);
+
+    //Style specific state
+    this->m_dt = this->m_timestep;
+    this->m_alpha = fire_alpha0;
+    this->m_npos = 0;
+    this->m_lsalpha = 0.0;
+    for (i=0; i<n3; ++i) {
+        this->m_dir[i]  = (this->m_style==CG) ? this->m_atom->GetForce(i) : 0.0;
+        this->m_fold[i] = this->m_atom->GetForce(i);
+    }
+
+    this->m_converged = this->m_stopped = false;
+    this->m_stopreason = "";
+    if (this->m_fmax < this->m_ftol) {
+        this->m_converged = this->m_stopped = true;
+        this->m_stopreason = "max force below tolerance";
+    }
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Perform one minimizer iteration
+ */
+bool Minimizer::Iterate()
+{
+    bool ok;
+
+    if (this->m_stopped) return true;
+
+    this->m_epotold = this->m_epot;
+    if (this->m_style==CG) ok = this->IterateCG();
+    else ok = this->IterateFIRE();
+    if (!ok) return false;
+
+    this->CheckConvergence();
+
+    //No error
+    return true;
+};
+
+
+/**
+ * One FIRE iteration (semi-implicit Euler MD with velocity mixing)
+ */
+bool Minimizer::IterateFIRE()
+{
+    int i, natoms, n3;
+    double power, vsq, dtmf, scale, dmax;
+    double *x, *f, *v;
+
+    natoms = this->m_atom->GetNAtoms();
+    n3 = 3 * natoms;
+    x = this->m_atom->GetPosition();
+    f = this->m_atom->GetForce();
+    v = this->m_dir;
+
+    /* check whether we are still going downhill */
+    power = vsq = 0.0;
+    for (i=0; i<n3; ++i) {
+        power += f[i]*v[i];
+        vsq   += v[i]*v[i];
+    }
+
+    if (power >= 0.0) {
+        /* mix velocity towards the force direction */
+        scale = (this->m_fsq > 0.0) ? this->m_alpha * sqrt(vsq/this->m_fsq) : 0.0;
+        for (i=0; i<n3; ++i) {
+            v[i] = (1.0 - this->m_alpha)*v[i] + scale*f[i];
+        }
+        if (++this->m_npos > fire_nmin) {
+            this->m_dt = fmin(this->m_dt*fire_finc, fire_dtmax*this->m_timestep);
+            this->m_alpha *= fire_falpha;
+        }
+    } else {
+        /* uphill: freeze and restart with a smaller time step */
+        this->m_dt *= fire_fdec;
+        this->m_alpha = fire_alpha0;
+        this->m_npos = 0;
+        azzero(v, n3);
+    }
+
+    /* propagate velocities, then positions, limiting the largest displacement */
+    dtmf = this->m_dt / mvsq2e / this->m_atom->GetMass();
+    dmax = 0.0;
+    for (i=0; i<n3; ++i) {
+        v[i] += dtmf * f[i];
+    }
+    for (i=0; i<natoms; ++i) {
+        double dsq = v[i]*v[i] + v[natoms+i]*v[natoms+i] + v[2*natoms+i]*v[2*natoms+i];
+        if (dsq > dmax) dmax = dsq;
+    }
+    dmax = sqrt(dmax) * this->m_dt;
+    scale = (dmax > this->m_maxstep) ? this->m_maxstep/dmax : 1.0;
+    for (i=0; i<n3; ++i) {
+        x[i] += scale * this->m_dt * v[i];
+    }
+
+    this->m_epot = this->EvalForce();
+    this->m_fmax = this->MaxForce(&this->m_fsq);
+
+    //No error
+    return true;
+};
+
+
+/**
+ * One Polak-Ribiere conjugate gradient iteration
+ */
+bool Minimizer::IterateCG()
+{
+    int i, n3;
+    double *f, *h, *fold;
+    double fsqold, beta, fdoth, alpha;
+
+    n3 = 3 * this->m_atom->GetNAtoms();
+    f = this->m_atom->GetForce();
+    h = this->m_dir;
+    fold = this->m_fold;
+    fsqold = this->m_fsq;
+
+    alpha = this->LineSearch();
+    if (alpha <= 0.0) {
+        this->m_stopped = true;
+        this->m_stopreason = "line search failed";
+        return true;
+    }
+    this->m_fmax = this->MaxForce(&this->m_fsq);
+
+    /* Polak-Ribiere update with automatic restart (PR+) */
+    beta = 0.0;
+    for (i=0; i<n3; ++i) {
+        beta += f[i]*(f[i] - fold[i]);
+    }
+    beta = (fsqold > 0.0) ? fmax(0.0, beta/fsqold) : 0.0;
+
+    fdoth = 0.0;
+    for (i=0; i<n3; ++i) {
+        h[i] = f[i] + beta*h[i];
+        fold[i] = f[i];
+        fdoth += f[i]*h[i];
+    }
+
+    /* not a descent direction: fall back to steepest descent */
+    if (fdoth <= 0.0) {
+        for (i=0; i<n3; ++i) h[i] = f[i];
+    }
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Backtracking line search with quadratic interpolation along the search direction
+ */
+double Minimizer::LineSearch()
+{
+    int i, iter, natoms, n3;
+    double *x, *f, *h;
+    double e0, slope, hmax, alpha, alphamax, ecurr;
+
+    natoms = this->m_atom->GetNAtoms();
+    n3 = 3 * natoms;
+    x = this->m_atom->GetPosition();
+    f = this->m_atom->GetForce();
+    h = this->m_dir;
+
+    /* directional derivative is -F.h, largest atomic displacement per unit step.
+       the starting point is kept unwrapped, since positions may be wrapped
+       into the box during force evaluations. */
+    slope = hmax = 0.0;
+    for (i=0; i<n3; ++i) {
+        slope += f[i]*h[i];
+        this->m_xold[i] = x[i] + this->m_atom->GetImageOffset(i);
+    }
+    for (i=0; i<natoms; ++i) {
+        double hsq = h[i]*h[i] + h[natoms+i]*h[natoms+i] + h[2*natoms+i]*h[2*natoms+i];
+        if (hsq > hmax) hmax = hsq;
+    }
+    hmax = sqrt(hmax);
+    if (slope <= 0.0 || hmax == 0.0) return 0.0;
+
+    /* initial guess: keep the first-order change of the previous step, capped by max step */
+    alphamax = this->m_maxstep / hmax;
+    alpha = (this->m_lsalpha > 0.0) ? fmin(2.0*this->m_lsalpha, alphamax) : alphamax;
+
+    e0 = this->m_epot;
+    for (iter=0; iter < ls_maxiter; ++iter) {
+        for (i=0; i<n3; ++i) x[i] = this->m_xold[i] + alpha*h[i] - this->m_atom->GetImageOffset(i);
+        ecurr = this->EvalForce();
+
+        /* sufficient decrease */
+        if (ecurr <= e0 - ls_armijo*alpha*slope) {
+            this->m_epot = ecurr;
+            this->m_lsalpha = alpha;
+            return alpha;
+        }
+
+        /* minimum of the quadratic through e0, slope and ecurr, kept within [0.1,0.5]*alpha */
+        double denom = 2.0*(ecurr - e0 + alpha*slope);
+        double anew = (denom > 0.0) ? slope*alpha*alpha/denom : 0.5*alpha;
+        alpha = fmax(0.1*alpha, fmin(0.5*alpha, anew));
+    }
+
+    /* restore starting point */
+    for (i=0; i<n3; ++i) x[i] = this->m_xold[i] - this->m_atom->GetImageOffset(i);
+    this->m_epot = this->EvalForce();
+    return 0.0;
+};
+
+
+/**
+ * Recompute forces and energy, migrating atoms between cells when they moved too far
+ */
+double Minimizer::EvalForce()
+{
+    this->m_integrator->MigrateAtoms();
+    this->m_force->ComputeForce(this->m_atom);
+    ++this->m_nfeval;
+    return this->m_atom->GetPotEnergy();
+};
+
+
+/**
+ * Largest atomic force and sum of squared forces
+ */
+double Minimizer::MaxForce(double *fsq)
+{
+    int i, natoms;
+    double *f, fmaxsq, sum;
+
+    natoms = this->m_atom->GetNAtoms();
+    f = this->m_atom->GetForce();
+
+    fmaxsq = sum = 0.0;
+    for (i=0; i<natoms; ++i) {
+        double fi = f[i]*f[i] + f[natoms+i]*f[natoms+i] + f[2*natoms+i]*f[2*natoms+i];
+        sum += fi;
+        if (fi > fmaxsq) fmaxsq = fi;
+    }
+
+    *fsq = sum;
+    return sqrt(fmaxsq);
+};
+
+
+/**
+ * Check convergence criteria after an iteration
+ */
+void Minimizer::CheckConvergence()
+{
+    double de;
+
+    if (this->m_stopped) return;
+
+    if (this->m_fmax < this->m_ftol) {
+        this->m_converged = this->m_stopped = true;
+        this->m_stopreason = "max force below tolerance";
+        return;
+    }
+
+    /* relative energy change; FIRE may go uphill when it resets, so only count descents */
+    de = this->m_epotold - this->m_epot;
+    if (de >= 0.0 && de < this->m_etol * 0.5*(fabs(this->m_epot) + fabs(this->m_epotold) + 1.0e-30)) {
+        this->m_converged = this->m_stopped = true;
+        this->m_stopreason = "energy change below tolerance";
+    }
+};
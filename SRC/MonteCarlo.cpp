@@ -0,0 +1,295 @@
+/**
+ * MonteCarlo
+ *
+ * @short This class provides Metropolis Monte Carlo with single particle moves. The energy change of a move is computed from the cell of the atom and its neighbor cells only, reusing the cell list of the integrator; sweeps over a checkerboard of cells run in parallel.
+ */
+
+#include "MonteCarlo.h"
+#include <stdlib.h>
+#include <algorithm>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+const double kboltz=0.0019872067;     /* boltzman constant in kcal/mol/K */
+const int mc_serialfreq=4;            /* every n-th sweep runs serially so that atoms can change cells */
+
+
+/**
+ * Default constructor
+ */
+MonteCarlo::MonteCarlo() :
+    m_atom(NULL),
+    m_force(NULL),
+    m_integrator(NULL),
+    m_temperature(0),
+    m_beta(0),
+    m_maxdisp(0.1),
+    m_seed(1),
+    m_random(1),
+    m_epot(0),
+    m_nsweeps(0),
+    m_ntrial(0),
+    m_naccept(0),
+    m_neigh(0),
+    m_colors(0)
+{};
+
+/**
+ * Default destructor
+ */
+MonteCarlo::~MonteCarlo()
+{
+    //Atoms and forces are owned by the integrator
+};
+
+/**
+ * Init
+ */
+bool MonteCarlo::Init(Atoms *atom, Force *force, Integrator *integrator)
+{
+    //Set pointers
+    if(!atom) {
+        std::cerr << "( ERROR ) Atoms null pointer... Abort Init!" << std::endl;
+        return false;
+    }
+    else this->m_atom = atom;
+
+    if(!force) {
+        std::cerr << "( ERROR ) Force null pointer... Abort Init!" << std::endl;
+        return false;
+    }
+    else this->m_force = force;
+
+    if(!integrator) {
+        std::cerr << "( ERROR ) Integrator null pointer... Abort Init!" << std::endl;
+        return false;
+    }
+    else this->m_integrator = integrator;
+
+    //No error
+    return true;
+};//Init
+
+
+/**
+ * Prepare a Monte Carlo run
+ */
+bool MonteCarlo::Setup()
+{
+    int i, c, c1, d, ncell, ngrid[3], reach[3], nblock[3], ncol1d[3];
+    const int *first;
+    std::vector<int> color1d[3];
+
+    if (this->m_temperature <= 0.0) {
+        std::cout << "( ERROR ) MonteCarlo::Setup(): temperature must be positive. Abort!" << std::endl;
+        return false;
+    }
+    this->m_beta = 1.0/(kboltz*this->m_temperature);
+
+    /* bin atoms and get the energy of the starting configuration */
+    this->m_integrator->UpdateCells();
+    this->m_force->ComputeForce(this->m_atom);
+    this->m_epot = this->m_atom->GetPotEnergy();
+
+    this->m_random.Seed(this->m_seed);
+    this->m_nsweeps = 0;
+    this->m_ntrial = 0;
+    this->m_naccept = 0;
+
+    /* each cell with its neighbor cells, from the cell pair list. the
+       largest offset of a neighbor along each dimension is the interaction reach. */
+    ncell = this->m_atom->GetNCells();
+    first = this->m_atom->GetPairFirst();
+    for (d=0; d < 3; ++d) {
+        ngrid[d] = this->m_integrator->GetNGrid(d);
+        reach[d] = 0;
+    }
+    this->m_neigh.assign(ncell, std::vector<int>(1));
+    for (c=0; c < ncell; ++c) this->m_neigh[c][0] = c;
+
+    for (c1=0; c1 < ncell; ++c1) {
+        for (i=first[c1]; i < first[c1+1]; ++i) {
+            int c2, k1[3], k2[3];
+
+            c2 = this->m_atom->GetPairCell(i);
+
+            /* several periodic images of a cell may be listed; energies use
+               the minimum image, so each neighbor cell is searched once */
+            if (std::find(this->m_neigh[c1].begin(), this->m_neigh[c1].end(), c2) == this->m_neigh[c1].end()) {
+                this->m_neigh[c1].push_back(c2);
+                this->m_neigh[c2].push_back(c1);
+            }
+
+            k1[0] = c1/(ngrid[1]*ngrid[2]);
+            k1[1] = (c1/ngrid[2])%ngrid[1];
+            k1[2] = c1%ngrid[2];
+            k2[0] = c2/(ngrid[1]*ngrid[2]);
+            k2[1] = (c2/ngrid[2])%ngrid[1];
+            k2[2] = c2%ngrid[2];
+            for (d=0; d < 3; ++d) {
+                int o = abs(k1[d] - k2[d]);
+                if (ngrid[d]-o < o) o = ngrid[d]-o;
+                if (o > reach[d]) reach[d] = o;
+            }
+        }
+    }
+
+    /* checkerboard: each axis is split into blocks of at least reach+1
+       cells and a cell's color is its position within the block, so cells
+       of one color are out of each other's reach and moves confined to such
+       cells read and write disjoint data. with less than two blocks along any axis
+       all sweeps run serially. */
+    this->m_colors.clear();
+    for (d=0; d < 3; ++d) {
+        int b;
+
+        nblock[d] = ngrid[d]/(reach[d]+1);
+        if (nblock[d] < 2) break;
+        color1d[d].resize(ngrid[d]);
+        for (b=0; b < nblock[d]; ++b) {
+            for (i=b*ngrid[d]/nblock[d]; i < (b+1)*ngrid[d]/nblock[d]; ++i)
+                color1d[d][i] = i - b*ngrid[d]/nblock[d];
+        }
+        ncol1d[d] = (ngrid[d] + nblock[d] - 1)/nblock[d];
+    }
+    if (d == 3) {
+        this->m_colors.resize(ncol1d[0]*ncol1d[1]*ncol1d[2]);
+        for (c=0; c < ncell; ++c) {
+            int k, m, n;
+            k = color1d[0][c/(ngrid[1]*ngrid[2])];
+            m = color1d[1][(c/ngrid[2])%ngrid[1]];
+            n = color1d[2][c%ngrid[2]];
+            this->m_colors[(k*ncol1d[1] + m)*ncol1d[2] + n].push_back(c);
+        }
+    }
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Perform one sweep
+ */
+bool MonteCarlo::Sweep()
+{
+    if (this->m_colors.empty() || (this->m_nsweeps % mc_serialfreq) == mc_serialfreq-1)
+        this->SweepSerial();
+    else
+        this->SweepCheckerboard();
+
+    ++this->m_nsweeps;
+    this->m_atom->SetPotEnergy(this->m_epot);
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Sweep over randomly chosen atoms
+ */
+void MonteCarlo::SweepSerial()
+{
+    int i, natoms;
+    double de = 0.0;
+    natoms = this->m_atom->GetNAtoms();
+
+    for (i=0; i < natoms; ++i) {
+        int idx = (int)(this->m_random.Uniform()*natoms);
+        if (this->TrialMove(this->m_random, idx, false, &de)) ++this->m_naccept;
+    }
+    this->m_ntrial += natoms;
+    this->m_epot += de;
+};
+
+
+/**
+ * Sweep over the checkerboard
+ */
+void MonteCarlo::SweepCheckerboard()
+{
+    int i, ncolor, ncell;
+    std::vector<int> order;
+    ncolor = this->m_colors.size();
+    ncell  = this->m_atom->GetNCells();
+
+    /* visit the colors in random order */
+    order.resize(ncolor);
+    for (i=0; i < ncolor; ++i) order[i] = i;
+    for (i=ncolor-1; i > 0; --i) {
+        int j = (int)(this->m_random.Uniform()*(i+1));
+        int t = order[i]; order[i] = order[j]; order[j] = t;
+    }
+
+    for (i=0; i < ncolor; ++i) {
+        const std::vector<int> &cells = this->m_colors[order[i]];
+        int j, ncells = cells.size();
+        long ntrial = 0, naccept = 0;
+        double de = 0.0;
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic,1) reduction(+:ntrial,naccept,de)
+#endif
+        for (j=0; j < ncells; ++j) {
+            int c, k, n;
+            c = cells[j];
+            n = this->m_atom->GetCellNAtoms(c);
+
+            /* the stream of random numbers depends on sweep and cell only,
+               so results do not depend on the number of threads */
+            Random random(this->m_seed + (uint64_t)this->m_nsweeps*ncell + c + 1);
+
+            for (k=0; k < n; ++k) {
+                int idx = this->m_atom->GetCellIndex(c, (int)(random.Uniform()*n));
+                if (this->TrialMove(random, idx, true, &de)) ++naccept;
+            }
+            ntrial += n;
+        }
+        this->m_ntrial  += ntrial;
+        this->m_naccept += naccept;
+        this->m_epot    += de;
+    }
+};
+
+
+/**
+ * Attempt a random displacement of one atom
+ */
+bool MonteCarlo::TrialMove(Random &random, int idx, bool incell, double *de)
+{
+    int natoms, cold, cnew;
+    double x0, y0, z0, x1, y1, z1, eold, enew, delta;
+    double *pos;
+
+    natoms = this->m_atom->GetNAtoms();
+    pos = this->m_atom->GetPosition();
+    x0 = pos[idx];
+    y0 = pos[natoms + idx];
+    z0 = pos[2*natoms + idx];
+    x1 = x0 + this->m_maxdisp*(2.0*random.Uniform() - 1.0);
+    y1 = y0 + this->m_maxdisp*(2.0*random.Uniform() - 1.0);
+    z1 = z0 + this->m_maxdisp*(2.0*random.Uniform() - 1.0);
+
+    cold = this->m_atom->GetAtomCell(idx);
+    cnew = this->m_integrator->CellIndex(x1, y1, z1);
+    if (incell && cnew != cold) return false;
+
+    /* energy change from the atom's old and new neighborhood only */
+    eold = this->m_force->ComputeAtomEnergy(this->m_atom, idx, x0, y0, z0, this->m_neigh[cold]);
+    enew = this->m_force->ComputeAtomEnergy(this->m_atom, idx, x1, y1, z1, this->m_neigh[cnew]);
+    delta = enew - eold;
+
+    if (delta > 0.0 && random.Uniform() >= exp(-this->m_beta*delta)) return false;
+
+    /* keep accepted positions wrapped into the box, like the cell lists expect */
+    pos[idx] = x1;
+    pos[natoms + idx] = y1;
+    pos[2*natoms + idx] = z1;
+    this->m_atom->WrapPosition(idx);
+    if (cnew != cold) this->m_atom->MoveAtomCell(idx, cnew);
+    *de += delta;
+    return true;
+};
@@ -1,9 +1,30 @@
 /******************************************************************************/
 #include "MyMD.h"
 
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+const int corrlevels=24;              /* levels of the MSD/VACF correlators: lags up to ~2^27 samples */
+
+/******************************************************************************/
+/* Default parameters. */
+
+MDParams::MDParams() :
+  natoms(0), mass(0.0), epsilon(0.0), sigma(0.0), rcut(0.0),
+  nsteps(0), dt(0.0), nprint(0)
+{
+  box[0] = box[1] = box[2] = 0.0;
+  tilt[0] = tilt[1] = tilt[2] = 0.0;
+  restfile[0] = trajfile[0] = ergfile[0] = '\0';
+}
+
+/******************************************************************************/
  /* Constructor. */
 
- MyMD::MyMD() {
+ MyMD::MyMD(const MDParams &p) : thermostat(NULL), rdf(NULL), msd(NULL), vacf(NULL), params(p),
+                                 nfi(0), erg(NULL), traj(NULL), rdffile(NULL), corrfile(NULL),
+                                 corrfreq(0), mode(MODE_MD), printpress(false), team(true) {
 
  /* Obtain the number of threads. */
  #if defined(_OPENMP)
@@ -11,102 +32,294 @@
      {
 	 if(0 == omp_get_thread_num()) {
 	     nthreads=omp_get_num_threads();
-	     printf("Running OpenMP version using %d threads\n", nthreads);
 	 }
      }
  #else
      nthreads=1;
  #endif
 
-   /* Read input and allocate classes memory. */
+  /* Allocate classes memory and apply parameters. */
   allocateMemory();
-  readInput();
-
-  /* Load initial position and velocity. */ 
-  readRestart();
-
-  /* Open energy and trajectory output files. */
-  erg=fopen(ergfile,"w");
-  traj=fopen(trajfile,"w");
+  atoms->Init(params.natoms);
+  atoms->SetMass(params.mass);
+  force->Init("PAIR", "LJ", params.epsilon, params.sigma);
+  atoms->SetRadCut(params.rcut);
+  atoms->SetBoxSize(params.box[0], params.box[1], params.box[2],
+                    params.tilt[0], params.tilt[1], params.tilt[2]);
+  integrator->SetTimestep(params.dt);
 
-  /* Initializes forces and energies. */
-  nfi = 0;
-  integrator->UpdateCells();
-  force->ComputeForce(atoms);
-  integrator->CalcKinEnergy();
+  /* Start at rest in the origin until positions are given. */
+  azzero(atoms->GetPosition(), 3*params.natoms);
+  azzero(atoms->GetVelocity(), 3*params.natoms);
+  azzero(atoms->GetForce(), 3*params.natoms);
 }
 
 /******************************************************************************/
 /* Destructor. */
 
 MyMD::~MyMD() {
-  delete atoms;
-  delete force;
+  /* the integrator owns atoms and force */
+  delete montecarlo;
+  delete minimizer;
   delete integrator;
 
   /* clean up: close files, free memory */
-  fclose(erg); 
-  fclose(traj);
-  printf("Simulation Done.\n");
+  if(erg)  fclose(erg);
+  if(traj) fclose(traj);
+  if(rdffile) fclose(rdffile);
+  if(corrfile) fclose(corrfile);
+  delete rdf;
+  delete msd;
+  delete vacf;
 }
 
 /******************************************************************************/
-/* Main MD loop. */
+/* Initializes cell list, forces and energies. */
 
-void MyMD::MDLoop() {
-  printf("Starting simulation with %d atoms for %d steps.\n",atoms->GetNAtoms(), nsteps);
-  printf("     NFI            TEMP            EKIN                 EPOT              ETOT\n");  
-  output();
-  for(nfi=1; nfi <= this->nsteps; ++nfi) {
+bool MyMD::Setup() {
+  nfi = 0;
+  if(!integrator->UpdateCells()) return false;
+  force->ComputeForce(atoms);
+  integrator->CalcKinEnergy();
+  return true;
+}
+
+/******************************************************************************/
+/* Propagate by n MD steps. */
+
+void MyMD::Step(int n) {
+#if defined(_OPENMP)
+  /* With several threads, one team runs all n steps. Not inside an ensemble
+     (replicas are spread over the threads already), not with correlators
+     (their own parallel regions would run on a single thread of the team)
+     and only with the half list kernel. */
+  if (team && n > 0 && omp_get_max_threads() > 1 && !omp_in_parallel()
+      && corrfreq <= 0 && force->pair->LJ->TeamKernel(atoms)) {
+    stepTeam(n);
+    return;
+  }
+#endif
+
+  for(int i=0; i<n; ++i) {
+    ++nfi;
 
     /* Write output, if requested. */
-    if ((nfi % nprint) == 0) output();
+    if (params.nprint > 0 && (nfi % params.nprint) == 0) output();
 
     /* Propagate atoms and recompute energies. */
     integrator->CalcVelocity();
     integrator->CalcKinEnergy();
 
-    /* Update cell list. */
-    if ((nfi % cellfreq) == 0)
-      integrator->UpdateCells();
+    /* Rescale velocities, if thermostatted (not owned by MyMD). */
+    if (thermostat)
+      thermostat->Apply(params.dt);
+
+    /* Feed the correlators, if requested. */
+    if (corrfreq > 0 && (nfi % corrfreq) == 0) {
+      msd->Sample();
+      vacf->Sample();
+    }
+  }
+}
+
+/******************************************************************************/
+/* Propagate by n MD steps with a single thread team: integration, cell
+   updates, forces and kinetic energy share their work between the threads
+   and are separated by barriers, instead of opening a parallel region per
+   phase with serial code in between. */
+
+void MyMD::stepTeam(int n) {
+#if defined(_OPENMP)
+#pragma omp parallel
+  {
+    int tid = omp_get_thread_num();
+    int nteam = omp_get_num_threads();
+
+    for(int i=0; i<n; ++i) {
+      /* Step counter and output on one thread, the others wait. */
+#pragma omp single
+      {
+        ++nfi;
+        if (params.nprint > 0 && (nfi % params.nprint) == 0) output();
+      }
+
+      /* Propagate atoms and recompute energies. */
+      integrator->CalcVelocity(tid, nteam);
+      integrator->CalcKinEnergy(tid, nteam);
+
+      /* Rescale velocities, if thermostatted (not owned by MyMD). */
+      if (thermostat) {
+#pragma omp single
+        thermostat->Apply(params.dt);
+      }
+    }
+  }
+#endif
+}
+
+/******************************************************************************/
+/* Main MD loop. */
+
+void MyMD::MDLoop(bool verbose) {
+  if(verbose) {
+    printf("Starting simulation with %d atoms for %d steps.\n",atoms->GetNAtoms(), params.nsteps);
+    printf("     NFI            TEMP            EKIN                 EPOT              ETOT%s\n",
+           printpress ? "                PRESS" : "");
+  }
+  output();
+  Step(params.nsteps);
+}
+
+/******************************************************************************/
+/* Energy minimization loop. */
+
+void MyMD::Minimize(std::string style) {
+  char minfile[BLEN+4];
+  if(!minimizer->SetStyle(style)) exit(1);
+  minimizer->SetTimestep(integrator->GetTimestep());
+  minimizer->Setup();
+  mode = MODE_MIN;
+
+  printf("Starting %s minimization with %d atoms for at most %d iterations.\n",
+         style.c_str(), atoms->GetNAtoms(), params.nsteps);
+  printf("     NFI            FMAX                 EPOT              DELTA-E     NFEV\n");
+  nfi = 0;
+  output();
+  while(nfi < params.nsteps && !minimizer->IsStopped()) {
+    ++nfi;
+    minimizer->Iterate();
+
+    /* Write output, if requested. */
+    if ((params.nprint > 0 && (nfi % params.nprint) == 0) || minimizer->IsStopped()) output();
   }
+  if(minimizer->IsStopped())
+    printf("Minimization stopped: %s.\n", minimizer->GetStopReason().c_str());
+  else
+    printf("Minimization not converged after %d iterations.\n", nfi);
+  printf("%d force evaluations.\n", minimizer->GetNForceEval());
+  mode = MODE_MD;
+
+  /* Save relaxed configuration for a subsequent MD run. */
+  sprintf(minfile, "%s.min", params.restfile);
+  WriteRestart(minfile);
+}
+
+/******************************************************************************/
+/* Metropolis Monte Carlo loop: nsteps sweeps at the temperature set in
+   the Monte Carlo engine. */
+
+void MyMD::MonteCarloLoop() {
+  char mcfile[BLEN+3];
+  if(!montecarlo->Setup()) exit(1);
+  mode = MODE_MC;
+
+  printf("Starting Monte Carlo with %d atoms at %.2f K for %d sweeps (%s).\n",
+         atoms->GetNAtoms(), montecarlo->GetTemp(), params.nsteps,
+         montecarlo->GetNColors() > 0 ? "checkerboard" : "serial");
+  printf("     NFI            TEMP               ACCEPT                 EPOT\n");
+  nfi = 0;
+  output();
+  while(nfi < params.nsteps) {
+    ++nfi;
+    montecarlo->Sweep();
+
+    /* Write output, if requested. */
+    if (params.nprint > 0 && (nfi % params.nprint) == 0) output();
+  }
+  mode = MODE_MD;
+
+  /* Save final configuration. */
+  sprintf(mcfile, "%s.mc", params.restfile);
+  WriteRestart(mcfile);
+}
+
+/******************************************************************************/
+/* Energies of the current configuration. */
+
+MDEnergies MyMD::GetEnergies() {
+  MDEnergies e;
+  e.nfi  = nfi;
+  e.temp = atoms->GetTemp();
+  e.ekin = atoms->GetKinEnergy();
+  e.epot = atoms->GetPotEnergy();
+  e.etot = e.ekin + e.epot;
+  e.press = atoms->GetPressure();
+  return e;
 }
 
 /******************************************************************************/
-/* Read input file. */
+/* Replace positions (planar x..., y..., z...) and recompute forces. */
 
-bool MyMD::readInput() {
+bool MyMD::SetPositions(const double *pos) {
+  int n3=3*atoms->GetNAtoms();
+  double *x=atoms->GetPosition();
+  for(int i=0; i<n3; ++i) x[i]=pos[i];
+  atoms->ClearImages();
+
+  /* positions may have changed arbitrarily: re-bin and recompute */
+  integrator->UpdateCells();
+  force->ComputeForce(atoms);
+  return true;
+}
+
+/******************************************************************************/
+/* Replace velocities (planar x..., y..., z...) and recompute kinetic energy. */
+
+bool MyMD::SetVelocities(const double *vel) {
+  int n3=3*atoms->GetNAtoms();
+  double *v=atoms->GetVelocity();
+  for(int i=0; i<n3; ++i) v[i]=vel[i];
+  integrator->CalcKinEnergy();
+  return true;
+}
+
+/******************************************************************************/
+/* Read input deck. */
+
+bool MyMD::ReadInput(FILE *fp, MDParams *p) {
   char line[BLEN];
-  if(get_a_line(stdin,line)) return 1;
-  atoms->Init(atoi(line));
-  fprintf(stderr, "%d", atoms->GetNAtoms());
-  if(get_a_line(stdin,line)) return 1;
-  atoms->SetMass(atof(line));
-  if(get_a_line(stdin,line)) return 1;
-  double epsilon=atof(line);
-  if(get_a_line(stdin,line)) return 1;
-  double sigma=atof(line);
-  force->Init("PAIR", "LJ", epsilon, sigma);  
-  if(get_a_line(stdin,line)) return 1;
-  atoms->SetRadCut(atof(line));
-  if(get_a_line(stdin,line)) return 1;
-  atoms->SetBoxSize(atof(line));
-  if(get_a_line(stdin,restfile)) return 1;
-  if(get_a_line(stdin,trajfile)) return 1;
-  if(get_a_line(stdin,ergfile)) return 1;
-  if(get_a_line(stdin,line)) return 1;
-  this->nsteps=atoi(line);
-  if(get_a_line(stdin,line)) return 1;
-  integrator->SetTimestep(atof(line));
-  if(get_a_line(stdin,line)) return 1;
-  this->nprint=atoi(line);
+  if(get_a_line(fp,line)) return false;
+  p->natoms=atoi(line);
+  if(get_a_line(fp,line)) return false;
+  p->mass=atof(line);
+  if(get_a_line(fp,line)) return false;
+  p->epsilon=atof(line);
+  if(get_a_line(fp,line)) return false;
+  p->sigma=atof(line);
+  if(get_a_line(fp,line)) return false;
+  p->rcut=atof(line);
+  if(get_a_line(fp,line)) return false;
+  /* box line: L (cubic), lx ly lz (orthorhombic) or lx ly lz xy xz yz (triclinic) */
+  int nbox=sscanf(line, "%lf%lf%lf%lf%lf%lf", &p->box[0], &p->box[1], &p->box[2],
+                  &p->tilt[0], &p->tilt[1], &p->tilt[2]);
+  if(nbox==1) p->box[1]=p->box[2]=p->box[0];
+  if(nbox==1 || nbox==3) p->tilt[0]=p->tilt[1]=p->tilt[2]=0.0;
+  else if(nbox!=6) {
+    std::cout << "( ERROR ) MyMD::ReadInput(): box needs 1, 3 or 6 numbers, got '" << line << "'. Abort!" << std::endl;
+    return false;
+  }
+  if(fabs(p->tilt[0]) > 0.5*p->box[0] || fabs(p->tilt[1]) > 0.5*p->box[0]
+     || fabs(p->tilt[2]) > 0.5*p->box[1]) {
+    std::cout << "( ERROR ) MyMD::ReadInput(): box tilt factors must not exceed half the box length. Abort!" << std::endl;
+    return false;
+  }
+  if(get_a_line(fp,p->restfile)) return false;
+  if(get_a_line(fp,p->trajfile)) return false;
+  if(get_a_line(fp,p->ergfile)) return false;
+  if(get_a_line(fp,line)) return false;
+  p->nsteps=atoi(line);
+  if(get_a_line(fp,line)) return false;
+  p->dt=atof(line);
+  if(get_a_line(fp,line)) return false;
+  p->nprint=atoi(line);
+  return true;
 }
 
 /******************************************************************************/
 /* Read restart. */
 
-void MyMD::readRestart() {
-  FILE *fp=fopen(restfile,"r");
+bool MyMD::ReadRestart(const char *fname) {
+  FILE *fp=fopen(fname,"r");
   if(fp) {
     int natoms=atoms->GetNAtoms();
     double index1, index2, index3;
@@ -124,11 +337,92 @@ void MyMD::readRestart() {
       atoms->SetVelocity(i+2*natoms, index3);
     }
     fclose(fp);
-    azzero(atoms->GetForce(), 3*nthreads*natoms);
+    azzero(atoms->GetForce(), 3*natoms);
+    atoms->ClearImages();
+    return true;
   } else {
     perror("cannot read restart file");
-    exit(1);
+    return false;
+  }
+}
+
+/******************************************************************************/
+/* Write restart. */
+
+bool MyMD::WriteRestart(const char *fname) {
+  FILE *fp=fopen(fname,"w");
+  if(fp) {
+    int natoms=atoms->GetNAtoms();
+    for(int i=0; i<natoms; ++i) {
+      fprintf(fp, "%20.14f %20.14f %20.14f\n", atoms->GetUnwrappedPosition(i),
+              atoms->GetUnwrappedPosition(i+natoms), atoms->GetUnwrappedPosition(i+2*natoms));
+    }
+    for(int i=0; i<natoms; ++i) {
+      fprintf(fp, "%20.16e %20.16e %20.16e\n", atoms->GetVelocity(i),
+              atoms->GetVelocity(i+natoms), atoms->GetVelocity(i+2*natoms));
+    }
+    fclose(fp);
+    return true;
+  } else {
+    perror("cannot write restart file");
+    return false;
+  }
+}
+
+/******************************************************************************/
+/* Open energy and trajectory output files and register the standard sinks
+   (optionally without screen output). */
+
+bool MyMD::OpenFiles(bool screen) {
+  erg=fopen(params.ergfile,"w");
+  traj=fopen(params.trajfile,"w");
+  if(!erg || !traj) {
+    perror("cannot open output files");
+    return false;
   }
+  if(screen) AddOutput(OutputScreen, NULL);
+  AddOutput(OutputEnergies, erg);
+  AddOutput(OutputTrajectory, traj);
+  return true;
+}
+
+/******************************************************************************/
+/* Accumulate g(r) in the force kernel and write it to fname at every output. */
+
+bool MyMD::OpenRdf(const char *fname, int nbins) {
+  rdf=new Rdf();
+  if(!rdf->Init(nbins, params.rcut, nthreads)) return false;
+  rdffile=fopen(fname,"w");
+  if(!rdffile) {
+    perror("cannot open rdf file");
+    return false;
+  }
+  force->pair->LJ->SetRdf(rdf);
+  AddOutput(OutputRdf, rdffile);
+  return true;
+}
+
+/******************************************************************************/
+/* Sample MSD and VACF every freq MD steps with multiple-tau correlators and
+   write them to fname at every output. */
+
+bool MyMD::OpenCorrelators(const char *fname, int freq) {
+  if(freq < 1) {
+    std::cout << "( ERROR ) MyMD::OpenCorrelators(): sampling interval must be positive. Abort!" << std::endl;
+    return false;
+  }
+  msd=new Correlator();
+  vacf=new Correlator();
+  if(!msd->Init(atoms, Correlator::MSD, corrlevels)) return false;
+  if(!vacf->Init(atoms, Correlator::VACF, corrlevels)) return false;
+  corrfile=fopen(fname,"w");
+  if(!corrfile) {
+    perror("cannot open correlator file");
+    return false;
+  }
+  corrfreq=freq;
+  AddOutput(OutputCorrelators, corrfile);
+  return true;
 }
 
 /******************************************************************************/
@@ -139,22 +433,101 @@ void MyMD::allocateMemory() {
   force = new Force();
   integrator = new Integrator();
   integrator->Init(atoms, force);
+  minimizer = new Minimizer();
+  minimizer->Init(atoms, force, integrator);
+  montecarlo = new MonteCarlo();
+  montecarlo->Init(atoms, force, integrator);
 }
 
 /******************************************************************************/
-/* Append data to output. */
+/* Output sinks. */
+
+void MyMD::AddOutput(MDOutputFunc func, void *data) {
+  sinks.push_back(func);
+  sinkdata.push_back(data);
+}
+
+void MyMD::ClearOutput() {
+  sinks.clear();
+  sinkdata.clear();
+}
+
+/* Pass the current state to all output sinks. */
 
 void MyMD::output() {
+  for(unsigned int i=0; i<sinks.size(); ++i) {
+    sinks[i](this, sinkdata[i]);
+  }
+}
+
+/* Energies to stdout. */
+
+void MyMD::OutputScreen(MyMD *md, void *data) {
+  OutputEnergies(md, stdout);
+}
+
+/* Energies to an open file (data is a FILE*). */
+
+void MyMD::OutputEnergies(MyMD *md, void *data) {
+  FILE *fp=(FILE *)data;
+  Atoms *atoms=md->atoms;
+  if(md->IsMinimizing()) {
+    fprintf(fp,"% 8d % 20.8f % 20.8f % 20.8e % 8d\n", md->nfi, md->minimizer->GetMaxForce(),
+            atoms->GetPotEnergy(), md->minimizer->GetDeltaEnergy(), md->minimizer->GetNForceEval());
+  } else if(md->IsMonteCarlo()) {
+    fprintf(fp,"% 8d % 20.8f % 20.8f % 20.8f\n", md->nfi, md->montecarlo->GetTemp(),
+            md->montecarlo->GetAcceptRatio(), atoms->GetPotEnergy());
+  } else {
+    fprintf(fp,"% 8d % 20.8f % 20.8f % 20.8f % 20.8f", md->nfi, atoms->GetTemp(), atoms->GetKinEnergy(),
+            atoms->GetPotEnergy(), atoms->GetKinEnergy()+atoms->GetPotEnergy());
+    if(md->printpress) fprintf(fp," % 20.8f", atoms->GetPressure());
+    fprintf(fp,"\n");
+  }
+}
+
+/* Accumulated g(r) to an open file (data is a FILE*). */
+
+void MyMD::OutputRdf(MyMD *md, void *data) {
+  md->rdf->Write((FILE *)data, md->atoms, md->nfi);
+}
+
+/* MSD and VACF to an open file (data is a FILE*). */
+
+void MyMD::OutputCorrelators(MyMD *md, void *data) {
+  FILE *fp=(FILE *)data;
+  double dt=md->corrfreq*md->params.dt;
+  fprintf(fp,"# nfi=%d samples=%ld\n#         TIME               MSD                  VACF\n",
+          md->nfi, md->msd->GetNSamples());
+  for(int k=0; k<md->msd->GetNLags(); ++k) {
+    if(md->msd->GetCount(k) == 0) continue;
+    fprintf(fp,"% 20.8f % 20.8f % 20.8e\n", md->msd->GetLag(k)*dt,
+            md->msd->GetValue(k), md->vacf->GetValue(k));
+  }
+  fprintf(fp,"\n\n");
+  fflush(fp);
+}
+
+/* XYZ frame to an open file (data is a FILE*). */
+
+void MyMD::OutputTrajectory(MyMD *md, void *data) {
   int i, natoms;
+  FILE *fp=(FILE *)data;
+  Atoms *atoms=md->atoms;
   natoms=atoms->GetNAtoms();
-  printf("% 8d % 20.8f % 20.8f % 20.8f % 20.8f\n", nfi, atoms->GetTemp(), atoms->GetKinEnergy(), 
-	 atoms->GetPotEnergy(), atoms->GetKinEnergy()+atoms->GetPotEnergy());
-  fprintf(erg,"% 8d % 20.8f % 20.8f % 20.8f % 20.8f\n", nfi, atoms->GetTemp(), atoms->GetKinEnergy(), 
-	  atoms->GetPotEnergy(), atoms->GetKinEnergy()+atoms->GetPotEnergy());
-  fprintf(traj,"%d\n nfi=%d etot=%20.8f\n", natoms, nfi, atoms->GetKinEnergy()+atoms->GetPotEnergy());
+  if(md->IsMinimizing() || md->IsMonteCarlo())
+    fprintf(fp,"%d\n nfi=%d epot=%20.8f", natoms, md->nfi, atoms->GetPotEnergy());
+  else
+    fprintf(fp,"%d\n nfi=%d etot=%20.8f", natoms, md->nfi, atoms->GetKinEnergy()+atoms->GetPotEnergy());
+  /* non-cubic boxes are recorded in the comment line */
+  if(atoms->IsTriclinic())
+    fprintf(fp," box=%.8f %.8f %.8f %.8f %.8f %.8f", atoms->GetBoxSize(0), atoms->GetBoxSize(1),
+            atoms->GetBoxSize(2), atoms->GetBoxTilt(0), atoms->GetBoxTilt(1), atoms->GetBoxTilt(2));
+  else if(atoms->GetBoxSize(0) != atoms->GetBoxSize(1) || atoms->GetBoxSize(0) != atoms->GetBoxSize(2))
+    fprintf(fp," box=%.8f %.8f %.8f", atoms->GetBoxSize(0), atoms->GetBoxSize(1), atoms->GetBoxSize(2));
+  fprintf(fp,"\n");
   for (i=0; i<natoms; ++i) {
-    fprintf(traj, "Ar  %20.8f %20.8f %20.8f\n", atoms->GetPosition(i), 
-	    atoms->GetPosition(natoms+i), atoms->GetPosition(2*natoms+i));
+    fprintf(fp, "Ar  %20.8f %20.8f %20.8f\n", atoms->GetUnwrappedPosition(i),
+	    atoms->GetUnwrappedPosition(natoms+i), atoms->GetUnwrappedPosition(2*natoms+i));
   }
 }
 
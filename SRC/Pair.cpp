@@ -20,3 +20,17 @@ void Pair::ComputeForce(Atoms *atom){
     LJ->ComputeForce(atom);
  }
 }
+
+void Pair::ComputeForce(Atoms *atom, int tid, int nthreads){
+ if(pot_type=="LJ"){
+    LJ->ComputeForce(atom, tid, nthreads);
+ }
+}
+
+double Pair::ComputeAtomEnergy(Atoms *atom, int idx, double x, double y, double z,
+                               const std::vector<int> &cells){
+ if(pot_type=="LJ"){
+    return LJ->ComputeAtomEnergy(atom, idx, x, y, z, cells);
+ }
+ return 0.0;
+}
@@ -7,36 +7,500 @@
 
 #include "Pair_LJ.h"
 #include "Helper.h"
+#include "Rdf.h"
+#include "ClusterList.h"
+#include "Layout.h"
 #include <math.h>
 #include <stdio.h>
+#include <algorithm>
 
 #if defined(_OPENMP)
 #include <omp.h>
 #endif
 
+const int listtrials=3;                /* timed force computations per kernel when selecting the list or layout */
+const double allpairs_ratio=3.0;       /* all-pairs kernel if it needs at most this many times the distance checks of the cell lists */
+const int allpairs_serial=500;         /* systems up to this size run the all-pairs kernel without threads */
+const int allpairs_tile=64;            /* atoms per tile of the all-pairs kernel */
+
+/* orders atom indices by one planar coordinate */
+struct AxisLess {
+    const double *r;
+    bool operator()(int a, int b) const { return r[a] < r[b]; }
+};
+
+
+/**
+ * Gather the atoms into cell order and sort each cell along the three axes
+ */
+template <class Layout>
+void Pair_LJ::SortCells(Atoms *atom, int tid, int nthreads)
+{
+    int k, ncell, natoms, chunk;
+    const int *order;
+    double *x;
+
+    ncell = atom->GetNCells();
+    natoms = atom->GetNAtoms();
+    order = atom->GetCellOrder();
+    x = atom->GetPosition();
+
+    /* cells get consecutive slots in traversal order */
+    if (tid == 0) {
+        int nslots = 0;
+
+        cellslot.resize(ncell);
+        for (k=0; k < ncell; ++k) {
+            cellslot[order[k]] = nslots;
+            nslots += atom->GetCellNAtoms(order[k]);
+        }
+        slotatom.resize(natoms);
+        atomslot.resize(natoms);
+        slotpos.resize(Layout::Size(natoms));
+        slotforce.resize(nthreads*Layout::Size(natoms));
+        sortidx.resize(3*natoms);
+        sortpos.resize(3*natoms);
+        cellcenter.resize(3*ncell);
+        teamsum.resize(2*nthreads);
+    }
+    team_barrier(nthreads);
+
+    /* each thread takes a contiguous chunk of cells in traversal order */
+    chunk = 1 + (ncell / nthreads);
+    for (k=tid*chunk; k < (tid+1)*chunk && k < ncell; ++k) {
+        int c, d, j, n, s0;
+
+        c = order[k];
+        n = atom->GetCellNAtoms(c);
+        s0 = cellslot[c];
+        for (j=0; j < n; ++j) {
+            int i = atom->GetCellIndex(c,j);
+            double *p = &slotpos[Layout::Offset(s0+j)];
+
+            slotatom[s0+j] = i;
+            atomslot[i] = s0+j;
+            for (d=0; d < 3; ++d) p[d*Layout::Stride(natoms)] = x[d*natoms + i];
+        }
+        for (d=0; d < 3; ++d) {
+            int *idx = &sortidx[d*natoms + s0];
+            double *pos = &sortpos[d*natoms + s0];
+            AxisLess less;
+
+            /* sorted as atoms, stored as slots */
+            for (j=0; j < n; ++j) idx[j] = slotatom[s0+j];
+            less.r = x + d*natoms;
+            std::sort(idx, idx + n, less);
+            for (j=0; j < n; ++j) {
+                pos[j] = x[d*natoms + idx[j]];
+                idx[j] = atomslot[idx[j]];
+            }
+            cellcenter[3*c+d] = (n > 0) ? 0.5*(pos[0] + pos[n-1]) : 0.0;
+        }
+    }
+    team_barrier(nthreads);
+}
+
+
 void Pair_LJ::ComputeForce(Atoms *atom) 
 {
-    double epot;
+    if (atom->UseGhosts()) {
+        ComputeForceGhost(atom);
+        return;
+    }
+    if (atom->GetClusters()) {
+        ComputeForceCluster(atom);
+        return;
+    }
+    if (UseAllPairs(atom)) {
+        ComputeForceAllPairs(atom);
+        return;
+    }
+
+    if (layout == LAYOUT_AUTO && listmode != LIST_FULL) SelectLayout(atom);
+    if (listmode == LIST_AUTO) SelectList(atom);
+    if (listmode == LIST_FULL) ComputeForceFull(atom);
+    else ComputeForceHalf(atom);
+}
+
+
+void Pair_LJ::ComputeForce(Atoms *atom, int tid, int nthreads)
+{
+    if (nthreads == 1) {
+        ComputeForce(atom);
+        return;
+    }
+
+    /* the other kernels open parallel regions of their own, which
+       get a single thread inside the team */
+    if (!TeamKernel(atom)) {
+        if (tid == 0) ComputeForce(atom);
+        team_barrier(nthreads);
+        return;
+    }
+
+    if (layout == LAYOUT_AOS) ComputeForceHalfTeam<LayoutAoS>(atom, tid, nthreads);
+    else if (layout == LAYOUT_AOSOA) ComputeForceHalfTeam<LayoutAoSoA>(atom, tid, nthreads);
+    else ComputeForceHalfTeam<LayoutSoA>(atom, tid, nthreads);
+}
+
+
+bool Pair_LJ::TeamKernel(Atoms *atom)
+{
+    return !atom->UseGhosts() && !atom->GetClusters() && !UseAllPairs(atom)
+        && listmode == LIST_HALF && layout != LAYOUT_AUTO;
+}
+
+
+void Pair_LJ::ComputeForceHalf(Atoms *atom)
+{
+    if (layout == LAYOUT_AOS) ComputeForceHalfLayout<LayoutAoS>(atom);
+    else if (layout == LAYOUT_AOSOA) ComputeForceHalfLayout<LayoutAoSoA>(atom);
+    else ComputeForceHalfLayout<LayoutSoA>(atom);
+}
+
+
+template <class Layout>
+void Pair_LJ::ComputeForceHalfLayout(Atoms *atom)
+{
+    double epot = 0.0, virial = 0.0;
+
+#if defined(_OPENMP)
+#pragma omp parallel reduction(+:epot,virial)
+#endif
+    {
+        int tid, nthreads;
+
+#if defined(_OPENMP)
+	nthreads=omp_get_num_threads();
+        tid=omp_get_thread_num();
+#else
+	nthreads=1;
+        tid=0;
+#endif
+        ComputeForceHalfThread<Layout>(atom, tid, nthreads, &epot, &virial);
+    }
+    StoreEnergies(atom, epot, virial);
+}
+
+
+template <class Layout>
+void Pair_LJ::ComputeForceHalfTeam(Atoms *atom, int tid, int nthreads)
+{
+    double epot, virial;
+
+    ComputeForceHalfThread<Layout>(atom, tid, nthreads, &epot, &virial);
+    teamsum[2*tid] = epot;
+    teamsum[2*tid+1] = virial;
+    team_barrier(nthreads);
+
+    /* add up in a fixed order, so results do not depend on thread timing */
+    if (tid == 0) {
+        epot = virial = 0.0;
+        for (int t=0; t < nthreads; ++t) {
+            epot += teamsum[2*t];
+            virial += teamsum[2*t+1];
+        }
+        StoreEnergies(atom, epot, virial);
+    }
+    team_barrier(nthreads);
+}
+
+
+template <class Layout>
+void Pair_LJ::ComputeForceHalfThread(Atoms *atom, int tid, int nthreads,
+                                     double *_epot, double *_virial)
+{
+    double c12,c6,rcsq,rcut,ecut,fcut,rdfscale,epot,virial;
+    long *hist;
+    bool sf;
+    double *fx, *fy, *fz;
+    const double *rx, *ry, *rz, *shift;
+    const int *active, *afirst, *order;
+    int i, c1, k1, chunk, fromidx, toidx, natoms, size, stride, nworkers;
+
+    SortCells<Layout>(atom, tid, nthreads);
+
+    /* if next cell lists are pending, the last thread of a team builds them
+       while the others share the cell pairs (its chunks below are empty).
+       the current cell lists stay untouched until they are swapped. */
+    nworkers = nthreads;
+    if (nthreads > 1 && atom->NextCellsPending()) {
+        nworkers = nthreads - 1;
+        /* a failure is recorded in atom and handled before the swap */
+        if (tid == nworkers) atom->BuildNextCells();
+    }
+
+    /* precompute some constants */
+    c12 = 4.0*epsilon*pow(sigma,12.0);
+    c6  = 4.0*epsilon*pow(sigma, 6.0);
+    rcut= atom->GetRadCut();
+    rcsq= rcut * rcut;
+    CutoffCoeffs(rcut, &ecut, &fcut);
+    sf = (style == LJ_SF);
+    natoms = atom->GetNAtoms();
+    active = atom->GetActivePairs();
+    afirst = atom->GetActiveFirst();
+    order = atom->GetCellOrder();
+    size = Layout::Size(natoms);
+    stride = Layout::Stride(natoms);
+    epot = 0.0;
+    virial = 0.0;
     
+    /* pair distances are binned into this thread's histogram, if requested */
+    hist = rdf ? rdf->GetHistogram(tid) : NULL;
+    rdfscale = rdf ? rdf->GetScale() : 0.0;
+    fx=&slotforce[tid*size];
+    azzero(fx,size);
+    fy=fx + stride;
+    fz=fx + 2*stride;
+    /* positions and forces are indexed by slot: the atoms of a cell are
+       contiguous, and cells that are close in traversal order are close
+       in memory, too. the components of a slot are at its offset from
+       the x, y and z base pointers, which are one stride apart. */
+    rx=&slotpos[0];
+    ry=rx + stride;
+    rz=rx + 2*stride;
+    int x;
+    /* self interaction of atoms in cell. each thread takes a contiguous
+       chunk of cells in traversal order, a compact region of the box. */
+    chunk = 1 + (atom->GetNCells() / nworkers);
+    for(i=tid*chunk; i < (tid+1)*chunk; ++i) {
+        int j;
+        //            cell_t *c1;
+        
+        if (i >= (atom->GetNCells())) break;
+        x = order[i];
+//            c1=atom->clist + j;
+//            afc=getlist(j) 
+        for (j=0; j < atom->GetCellNAtoms(x)-1; ++j) {
+//	    for (j=0; j < GetCellData()-1; ++j) {  
+            int ii,k;
+            double rx1, ry1, rz1;		
+ //               ii=c1->idxlist[j];
+            ii=Layout::Offset(cellslot[x] + j);
+            
+            rx1=rx[ii];
+            ry1=ry[ii];
+            rz1=rz[ii];
+    
+            for(k=j+1; k < atom->GetCellNAtoms(x); ++k) {
+                int jj;
+                double rx2,ry2,rz2,rsq;
+
+                jj=Layout::Offset(cellslot[x] + k); 
+                /* get distance between particle i and j. positions are
+                   wrapped, so atoms of one cell need no periodic shift. */
+                rx2=rx1 - rx[jj];
+                ry2=ry1 - ry[jj];
+                rz2=rz1 - rz[jj];
+                rsq = rx2*rx2 + ry2*ry2 + rz2*rz2;
+
+                /* compute force and energy if within cutoff */
+                if (rsq < rcsq) {
+                    double r6,rinv,ffac;
+
+                    rinv=1.0/rsq;
+                    r6=rinv*rinv*rinv;
+                
+                    ffac = (12.0*c12*r6 - 6.0*c6)*r6*rinv;
+                    epot += r6*(c12*r6 - c6) - ecut;
+                    if (sf) {
+                        double r = sqrt(rsq);
+                        ffac -= fcut/r;
+                        epot += fcut*(r - rcut);
+                    }
+                    virial += ffac*rsq;
+                    if (hist) ++hist[(int)(rsq*rdfscale)];
+
+                    fx[ii] += rx2*ffac;
+                    fy[ii] += ry2*ffac;
+                    fz[ii] += rz2*ffac;
+                    fx[jj] -= rx2*ffac;
+                    fy[jj] -= ry2*ffac;
+                    fz[jj] -= rz2*ffac;
+                }
+            }
+        }
+    }    
+
+    /* interaction of atoms in different cells, over the cell pairs left
+       active after pruning by bounding boxes. the atoms of each cell
+       are sorted along the three axes and every cell pair is swept along
+       the axis of its largest separation: atoms whose coordinates differ
+       by more than the cutoff are out of range, so each atom of the first
+       cell only visits a window of the second one. the active pairs are
+       grouped by first cell in traversal order, and each thread takes a
+       contiguous chunk of them: pairs sharing a cell follow each other. */
+    chunk = 1 + (atom->GetNActivePairs() / nworkers);
+    k1 = 0;
+    for(i=tid*chunk; i < (tid+1)*chunk; ++i) {
+        int j, c2, n1, n2, d, lo;
+        const int *idx1, *idx2;
+        const double *pos1, *pos2;
+        double sep, rproj;
+
+        if (i >= (atom->GetNActivePairs())) break;
+        x = active[i];
+
+        /* the first cell is stored once per cell */
+        while (afirst[k1+1] <= i) ++k1;
+        c1 = order[k1];
+        c2 = atom->GetPairCell(x);
+        shift = atom->GetPairShift(x);
+        n1 = atom->GetCellNAtoms(c1);
+        n2 = atom->GetCellNAtoms(c2);
+        if (n1 == 0 || n2 == 0) continue;
+
+        /* sweep axis: largest separation of the (shifted) cell centers */
+        d = 0;
+        sep = 0.0;
+        for (j=0; j < 3; ++j) {
+            double s = fabs(cellcenter[3*c1+j] - shift[j] - cellcenter[3*c2+j]);
+            if (s > sep) {
+                sep = s;
+                d = j;
+            }
+        }
+        idx1 = &sortidx[d*natoms + cellslot[c1]];
+        idx2 = &sortidx[d*natoms + cellslot[c2]];
+        pos1 = &sortpos[d*natoms + cellslot[c1]];
+        pos2 = &sortpos[d*natoms + cellslot[c2]];
+
+        /* window with a margin for round-off */
+        rproj = rcut * (1.0 + 1.0e-12);
+        lo = 0;
+        for (j=0; j < n1; ++j) {
+            int ii, k;
+            double rx1, ry1, rz1, p1;
+
+            /* atoms of the second cell below the window of this atom
+               are below the windows of all following ones, too */
+            p1 = pos1[j] - shift[d];
+            while (lo < n2 && pos2[lo] <= p1 - rproj) ++lo;
+            if (lo == n2) break;
+
+            ii=Layout::Offset(idx1[j]);
+            /* apply the periodic shift of the cell pair once per atom */
+            rx1=rx[ii] - shift[0];
+            ry1=ry[ii] - shift[1];
+            rz1=rz[ii] - shift[2];
+
+            for(k=lo; k < n2 && pos2[k] < p1 + rproj; ++k) {
+                int jj;
+                double rx2,ry2,rz2,rsq;
+
+                jj = Layout::Offset(idx2[k]);
+                /* get distance between particle i and j */
+                rx2=rx1 - rx[jj];
+                ry2=ry1 - ry[jj];
+                rz2=rz1 - rz[jj];
+                rsq = rx2*rx2 + ry2*ry2 + rz2*rz2;
+
+                /* compute force and energy if within cutoff */
+                if (rsq < rcsq) {
+                    double r6,rinv,ffac;
+
+                    rinv=1.0/rsq;
+
+                    r6=rinv*rinv*rinv;
+                
+                    ffac = (12.0*c12*r6 - 6.0*c6)*r6*rinv;
+                    epot += r6*(c12*r6 - c6) - ecut;
+                    if (sf) {
+                        double r = sqrt(rsq);
+                        ffac -= fcut/r;
+                        epot += fcut*(r - rcut);
+                    }
+                    virial += ffac*rsq;
+                    if (hist) ++hist[(int)(rsq*rdfscale)];
+
+                    fx[ii] += rx2*ffac;
+                    fy[ii] += ry2*ffac;
+                    fz[ii] += rz2*ffac;
+                    fx[jj] -= rx2*ffac;
+                    fy[jj] -= ry2*ffac;
+                    fz[jj] -= rz2*ffac;
+                }
+            }
+        }
+    }
+
+    /* before reducing the forces, we have to make sure 
+       that all threads are done adding to them. */
+    team_barrier(nthreads);
+    /* set equal chunks of index ranges */
+    i = 1 + (natoms / nthreads);
+    fromidx = tid * i;
+    toidx = fromidx + i;
+    if (toidx > natoms) toidx = natoms;
+
+    /* reduce the slot forces of all threads and scatter them back to
+       the atoms. since we have threads already spawned, we do this in
+       parallel. */
+    for (i=fromidx; i < toidx; ++i) {
+        int d, t, o;
+        double *frc = atom->GetForce();
+
+        o = Layout::Offset(atomslot[i]);
+        for (d=0; d < 3; ++d) {
+            double sum = 0.0;
+
+            for (t=0; t < nthreads; ++t) sum += slotforce[t*size + o + d*stride];
+            frc[d*natoms + i] = sum;
+        }
+    }
+    *_epot = epot;
+    *_virial = virial;
+}
+
+
+void Pair_LJ::StoreEnergies(Atoms *atom, double epot, double virial)
+{
+    if (tail) {
+        double etail, wtail;
+        TailCorrection(atom, &etail, &wtail);
+        epot += etail;
+        virial += wtail;
+    }
+    if (rdf) rdf->AddSample();
+    atom->SetPotEnergy(epot);
+    atom->SetVirial(virial);
+}
+
+
+
+void Pair_LJ::ComputeForceGhost(Atoms *atom)
+{
+    double epot = 0.0, virial = 0.0;
+
 #if defined(_OPENMP)
-#pragma omp parallel reduction(+:epot)
+#pragma omp parallel reduction(+:epot,virial)
 #endif
     {
-        double c12,c6,boxby2,rcsq;
+        double c12,c6,rcsq,rcut,ecut,fcut,rdfscale;
+        long *hist;
+        bool sf;
         double *fx, *fy, *fz;
-        double *rx, *ry, *rz;
-        int i, tid, fromidx, toidx, natoms, nthreads;
+        double *px, *py, *pz;
+        const double *x, *shift;
+        const int *owner;
+        int i, tid, fromidx, toidx, natoms, npad, nthreads;
 
         /* precompute some constants */
         c12 = 4.0*epsilon*pow(sigma,12.0);
         c6  = 4.0*epsilon*pow(sigma, 6.0);
-        rcsq= atom->GetRadCut() * atom->GetRadCut();
-        boxby2 = 0.5*atom->GetBoxSize();
+        rcut= atom->GetRadCut();
+        rcsq= rcut * rcut;
+        CutoffCoeffs(rcut, &ecut, &fcut);
+        sf = (style == LJ_SF);
         natoms = atom->GetNAtoms();
+        npad = natoms + atom->GetNGhosts();
+        x = atom->GetPosition();
+        shift = atom->GetGhostShift();
+        owner = atom->GetGhostOwner();
         epot = 0.0;
-        
-        /* let each thread operate on a different
-           part of the enlarged force array */
+        virial = 0.0;
+
 #if defined(_OPENMP)
 	nthreads=omp_get_num_threads();
         tid=omp_get_thread_num();
@@ -44,54 +508,76 @@ void Pair_LJ::ComputeForce(Atoms *atom)
 	nthreads=1;
         tid=0;
 #endif
-        fx=atom->GetForce() + (3*tid*natoms);
-        azzero(fx,3*natoms);
-        fy=atom->GetForce() + ((3*tid+1)*natoms);
-        fz=atom->GetForce() + ((3*tid+2)*natoms);
-        rx=atom->GetPosition();
-        ry=atom->GetPosition() + natoms;
-        rz=atom->GetPosition() + 2*natoms;
-	int x;
+        /* pair distances are binned into this thread's histogram, if requested */
+        hist = rdf ? rdf->GetHistogram(tid) : NULL;
+        rdfscale = rdf ? rdf->GetScale() : 0.0;
+        px=atom->GetPadPosition();
+        py=px + npad;
+        pz=px + 2*npad;
+
+        /* refresh padded positions: atoms, then shifted ghost copies */
+#if defined(_OPENMP)
+#pragma omp for
+#endif
+        for (i=0; i < natoms; ++i) {
+            px[i] = x[i];
+            py[i] = x[natoms+i];
+            pz[i] = x[2*natoms+i];
+        }
+#if defined(_OPENMP)
+#pragma omp for
+#endif
+        for (i=natoms; i < npad; ++i) {
+            int o = owner[i-natoms];
+            px[i] = x[o]          + shift[3*(i-natoms)];
+            py[i] = x[natoms+o]   + shift[3*(i-natoms)+1];
+            pz[i] = x[2*natoms+o] + shift[3*(i-natoms)+2];
+        }
+
+        fx=atom->GetPadForce() + (3*tid*npad);
+        azzero(fx,3*npad);
+        fy=fx + npad;
+        fz=fx + 2*npad;
+
         /* self interaction of atoms in cell */
-        for(i=0; i < atom->GetNCells(); i += nthreads) {
-            int j;
-	    //            cell_t *c1;
-            
-            j = x = i + tid;
-            if (j >= (atom->GetNCells())) break;
-//            c1=atom->clist + j;
-//            afc=getlist(j) 
-            for (j=0; j < atom->GetCellNAtoms(x)-1; ++j) {
-//	    for (j=0; j < GetCellData()-1; ++j) {  
-                int ii,k;
-                double rx1, ry1, rz1;		
- //               ii=c1->idxlist[j];
-		ii=atom->GetCellIndex(x,j);
-		
-                rx1=rx[ii];
-                ry1=ry[ii];
-                rz1=rz[ii];
-        
-                for(k=j+1; k < atom->GetCellNAtoms(x); ++k) {
+        for (i=tid; i < atom->GetNCells(); i += nthreads) {
+            int j, n;
+            n = atom->GetCellNAtoms(i);
+
+            for (j=0; j < n-1; ++j) {
+                int ii, k;
+                double rx1, ry1, rz1;
+
+                ii=atom->GetCellIndex(i,j);
+                rx1=px[ii];
+                ry1=py[ii];
+                rz1=pz[ii];
+
+                for (k=j+1; k < n; ++k) {
                     int jj;
                     double rx2,ry2,rz2,rsq;
 
-		    jj=atom->GetCellIndex(x,k); 
-                    /* get distance between particle i and j */
-                    rx2=pbc(rx1 - rx[jj], boxby2, atom->GetBoxSize());
-                    ry2=pbc(ry1 - ry[jj], boxby2, atom->GetBoxSize());
-                    rz2=pbc(rz1 - rz[jj], boxby2, atom->GetBoxSize());
+                    jj=atom->GetCellIndex(i,k);
+                    rx2=rx1 - px[jj];
+                    ry2=ry1 - py[jj];
+                    rz2=rz1 - pz[jj];
                     rsq = rx2*rx2 + ry2*ry2 + rz2*rz2;
 
-                    /* compute force and energy if within cutoff */
                     if (rsq < rcsq) {
                         double r6,rinv,ffac;
 
                         rinv=1.0/rsq;
                         r6=rinv*rinv*rinv;
-                    
+
                         ffac = (12.0*c12*r6 - 6.0*c6)*r6*rinv;
-                        epot += r6*(c12*r6 - c6);
+                        epot += r6*(c12*r6 - c6) - ecut;
+                        if (sf) {
+                            double r = sqrt(rsq);
+                            ffac -= fcut/r;
+                            epot += fcut*(r - rcut);
+                        }
+                        virial += ffac*rsq;
+                        if (hist) ++hist[(int)(rsq*rdfscale)];
 
                         fx[ii] += rx2*ffac;
                         fy[ii] += ry2*ffac;
@@ -102,51 +588,50 @@ void Pair_LJ::ComputeForce(Atoms *atom)
                     }
                 }
             }
-        }    
+        }
 
-        /* interaction of atoms in different cells */
-        for(i=0; i < atom->GetNPairs(); i += nthreads) {
-            int j;
-	    //            const cell_t *c1, *c2;
+        /* interaction of atoms in different cells, the second one possibly a ghost cell */
+        for (i=tid; i < atom->GetNGhostPairs(); i += nthreads) {
+            int j, c1, c2, n1, n2;
+            c1 = atom->GetGhostPairItem(2*i);
+            c2 = atom->GetGhostPairItem(2*i+1);
+            n1 = atom->GetCellNAtoms(c1);
+            n2 = atom->GetCellNAtoms(c2);
 
-            j = x = i + tid;
-            if (x >= (atom->GetNPairs())) break;
-	  
-        //    c1=atom->clist + atom->plist[2*x];
-        //    c2=atom->clist + atom->plist[2*x+1];
-        
-            for (j=0; j < atom->GetCellNAtoms(atom->GetPairItem(2*x)); ++j) {
+            for (j=0; j < n1; ++j) {
                 int ii, k;
                 double rx1, ry1, rz1;
 
-                ii=atom->GetCellIndex(atom->GetPairItem(2*x),j);
-                rx1=rx[ii];
-                ry1=ry[ii];
-                rz1=rz[ii];
-        
-                for(k=0; k < atom->GetCellNAtoms(atom->GetPairItem(2*x+1)); ++k) {
+                ii=atom->GetCellIndex(c1,j);
+                rx1=px[ii];
+                ry1=py[ii];
+                rz1=pz[ii];
+
+                for (k=0; k < n2; ++k) {
                     int jj;
                     double rx2,ry2,rz2,rsq;
-                
-                   // jj=c2->idxlist[k];
-		    
-		    jj = atom->GetCellIndex(atom->GetPairItem(2*x+1),k);
-                    /* get distance between particle i and j */
-                    rx2=pbc(rx1 - rx[jj], boxby2, atom->GetBoxSize());
-                    ry2=pbc(ry1 - ry[jj], boxby2, atom->GetBoxSize());
-                    rz2=pbc(rz1 - rz[jj], boxby2, atom->GetBoxSize());
+
+                    jj=atom->GetCellIndex(c2,k);
+                    rx2=rx1 - px[jj];
+                    ry2=ry1 - py[jj];
+                    rz2=rz1 - pz[jj];
                     rsq = rx2*rx2 + ry2*ry2 + rz2*rz2;
 
-                    /* compute force and energy if within cutoff */
                     if (rsq < rcsq) {
                         double r6,rinv,ffac;
 
                         rinv=1.0/rsq;
-
                         r6=rinv*rinv*rinv;
-                    
+
                         ffac = (12.0*c12*r6 - 6.0*c6)*r6*rinv;
-                        epot += r6*(c12*r6 - c6);
+                        epot += r6*(c12*r6 - c6) - ecut;
+                        if (sf) {
+                            double r = sqrt(rsq);
+                            ffac -= fcut/r;
+                            epot += fcut*(r - rcut);
+                        }
+                        virial += ffac*rsq;
+                        if (hist) ++hist[(int)(rsq*rdfscale)];
 
                         fx[ii] += rx2*ffac;
                         fy[ii] += ry2*ffac;
@@ -159,7 +644,543 @@ void Pair_LJ::ComputeForce(Atoms *atom)
             }
         }
 
-        /* before reducing the forces, we have to make sure 
+#if defined (_OPENMP)
+#pragma omp barrier
+#endif
+        /* reduce padded forces of all threads into the first copy */
+        i = 1 + (3*npad / nthreads);
+        fromidx = tid * i;
+        toidx = fromidx + i;
+        if (toidx > 3*npad) toidx = 3*npad;
+
+        for (i=1; i < nthreads; ++i) {
+            int offs, j;
+            double *frc = atom->GetPadForce();
+
+            offs = 3*i*npad;
+            for (j=fromidx; j < toidx; ++j) {
+                frc[j] += frc[offs+j];
+            }
+        }
+#if defined (_OPENMP)
+#pragma omp barrier
+#endif
+
+        /* copy forces of the atoms and fold ghost forces back to their owners */
+#if defined(_OPENMP)
+#pragma omp single
+#endif
+        {
+            double *f = atom->GetForce();
+            const double *pf = atom->GetPadForce();
+
+            for (i=0; i < natoms; ++i) {
+                f[i]          = pf[i];
+                f[natoms+i]   = pf[npad+i];
+                f[2*natoms+i] = pf[2*npad+i];
+            }
+            for (i=natoms; i < npad; ++i) {
+                int o = owner[i-natoms];
+                f[o]          += pf[i];
+                f[natoms+o]   += pf[npad+i];
+                f[2*natoms+o] += pf[2*npad+i];
+            }
+        }
+    }
+    StoreEnergies(atom, epot, virial);
+}
+
+
+void Pair_LJ::ComputeForceCluster(Atoms *atom)
+{
+    double epot = 0.0, virial = 0.0;
+    ClusterList *cl = atom->GetClusters();
+
+#if defined(_OPENMP)
+#pragma omp parallel reduction(+:epot,virial)
+#endif
+    {
+        double c12,c6,rcsq,rcut,ecut,fcut,rdfscale;
+        long *hist;
+        bool sf;
+        double *fx, *fy, *fz;
+        double *px, *py, *pz;
+        const double *x;
+        const int *slotatom, *atomslot, *ncl, *jlist;
+        const ClusterEntry *entry;
+        int i, e, tid, fromidx, toidx, natoms, nslots, nentries, nthreads;
+
+        /* precompute some constants */
+        c12 = 4.0*epsilon*pow(sigma,12.0);
+        c6  = 4.0*epsilon*pow(sigma, 6.0);
+        rcut= atom->GetRadCut();
+        rcsq= rcut * rcut;
+        CutoffCoeffs(rcut, &ecut, &fcut);
+        sf = (style == LJ_SF);
+        natoms = atom->GetNAtoms();
+        nslots = cl->GetNSlots();
+        nentries = cl->GetNEntries();
+        x = atom->GetPosition();
+        slotatom = cl->GetSlotAtom();
+        atomslot = cl->GetAtomSlot();
+        ncl = cl->GetClusterNAtoms();
+        entry = cl->GetEntries();
+        jlist = cl->GetJList();
+        epot = 0.0;
+        virial = 0.0;
+
+#if defined(_OPENMP)
+	nthreads=omp_get_num_threads();
+        tid=omp_get_thread_num();
+#else
+	nthreads=1;
+        tid=0;
+#endif
+        /* pair distances are binned into this thread's histogram, if requested */
+        hist = rdf ? rdf->GetHistogram(tid) : NULL;
+        rdfscale = rdf ? rdf->GetScale() : 0.0;
+        px=cl->GetPosition();
+        py=px + nslots;
+        pz=px + 2*nslots;
+
+        /* refresh positions in slot order (padding slots stay at the origin) */
+#if defined(_OPENMP)
+#pragma omp for
+#endif
+        for (i=0; i < nslots; ++i) {
+            int a = slotatom[i];
+            if (a < 0) continue;
+            px[i] = x[a];
+            py[i] = x[natoms+a];
+            pz[i] = x[2*natoms+a];
+        }
+
+        fx=cl->GetForce() + (3*tid*nslots);
+        azzero(fx,3*nslots);
+        fy=fx + nslots;
+        fz=fx + 2*nslots;
+
+        /* all j-clusters of an i-cluster and shift: forces on the i-cluster
+           stay in local arrays, the 4x4 block of every cluster pair is
+           computed with fixed trip counts and masks instead of branches */
+        for (e=tid; e < nentries; e += nthreads) {
+            int a, p, ci, ni;
+            double xi[cluster_size], yi[cluster_size], zi[cluster_size];
+            double fxi[cluster_size], fyi[cluster_size], fzi[cluster_size];
+
+            ci = entry[e].ci;
+            ni = ncl[ci];
+            for (a=0; a < cluster_size; ++a) {
+                xi[a] = px[ci*cluster_size+a] - entry[e].shift[0];
+                yi[a] = py[ci*cluster_size+a] - entry[e].shift[1];
+                zi[a] = pz[ci*cluster_size+a] - entry[e].shift[2];
+                fxi[a] = fyi[a] = fzi[a] = 0.0;
+            }
+
+            for (p=entry[e].jbeg; p < entry[e].jend; ++p) {
+                int b, cj, nj;
+                bool self;
+                const double *xj, *yj, *zj;
+                double fxj[cluster_size], fyj[cluster_size], fzj[cluster_size];
+
+                cj = jlist[p];
+                nj = ncl[cj];
+                self = (cj == ci);
+                xj = px + cj*cluster_size;
+                yj = py + cj*cluster_size;
+                zj = pz + cj*cluster_size;
+                for (b=0; b < cluster_size; ++b) fxj[b] = fyj[b] = fzj[b] = 0.0;
+
+                for (a=0; a < cluster_size; ++a) {
+                    for (b=0; b < cluster_size; ++b) {
+                        double rx2,ry2,rz2,rsq,rinv,r6,ffac,ep;
+                        bool in;
+
+                        rx2=xi[a] - xj[b];
+                        ry2=yi[a] - yj[b];
+                        rz2=zi[a] - zj[b];
+                        rsq = rx2*rx2 + ry2*ry2 + rz2*rz2;
+
+                        /* within cutoff, both slots filled, each pair of a cluster once */
+                        in = (rsq < rcsq) && (a < ni) && (b < nj) && (!self || b > a);
+                        rinv = in ? 1.0/rsq : 0.0;
+                        r6=rinv*rinv*rinv;
+
+                        ffac = (12.0*c12*r6 - 6.0*c6)*r6*rinv;
+                        ep = r6*(c12*r6 - c6) - (in ? ecut : 0.0);
+                        if (sf) {
+                            double r = sqrt(rsq);
+                            ffac -= in ? fcut/r : 0.0;
+                            ep += in ? fcut*(r - rcut) : 0.0;
+                        }
+                        epot += ep;
+                        virial += ffac*rsq;
+
+                        fxi[a] += rx2*ffac;
+                        fyi[a] += ry2*ffac;
+                        fzi[a] += rz2*ffac;
+                        fxj[b] -= rx2*ffac;
+                        fyj[b] -= ry2*ffac;
+                        fzj[b] -= rz2*ffac;
+                    }
+                }
+                for (b=0; b < cluster_size; ++b) {
+                    fx[cj*cluster_size+b] += fxj[b];
+                    fy[cj*cluster_size+b] += fyj[b];
+                    fz[cj*cluster_size+b] += fzj[b];
+                }
+
+                if (hist) {
+                    for (a=0; a < ni; ++a) {
+                        for (b=(self ? a+1 : 0); b < nj; ++b) {
+                            double rx2,ry2,rz2,rsq;
+
+                            rx2=xi[a] - xj[b];
+                            ry2=yi[a] - yj[b];
+                            rz2=zi[a] - zj[b];
+                            rsq = rx2*rx2 + ry2*ry2 + rz2*rz2;
+                            if (rsq < rcsq) ++hist[(int)(rsq*rdfscale)];
+                        }
+                    }
+                }
+            }
+            for (a=0; a < cluster_size; ++a) {
+                fx[ci*cluster_size+a] += fxi[a];
+                fy[ci*cluster_size+a] += fyi[a];
+                fz[ci*cluster_size+a] += fzi[a];
+            }
+        }
+
+#if defined (_OPENMP)
+#pragma omp barrier
+#endif
+        /* sum the slot forces of all threads into the forces of the atoms */
+        i = 1 + (natoms / nthreads);
+        fromidx = tid * i;
+        toidx = fromidx + i;
+        if (toidx > natoms) toidx = natoms;
+
+        {
+            double *f = atom->GetForce();
+            const double *frc = cl->GetForce();
+
+            for (i=fromidx; i < toidx; ++i) {
+                int t, s;
+                double sx = 0.0, sy = 0.0, sz = 0.0;
+
+                s = atomslot[i];
+                for (t=0; t < nthreads; ++t) {
+                    sx += frc[3*t*nslots + s];
+                    sy += frc[(3*t+1)*nslots + s];
+                    sz += frc[(3*t+2)*nslots + s];
+                }
+                f[i]          = sx;
+                f[natoms+i]   = sy;
+                f[2*natoms+i] = sz;
+            }
+        }
+    }
+    StoreEnergies(atom, epot, virial);
+}
+
+
+void Pair_LJ::ComputeForceFull(Atoms *atom)
+{
+    double epot = 0.0, virial = 0.0;
+
+#if defined(_OPENMP)
+#pragma omp parallel reduction(+:epot,virial)
+#endif
+    {
+        double c12,c6,rcsq,rcut,ecut,fcut,rdfscale;
+        long *hist;
+        bool sf;
+        double *f, *rx, *ry, *rz;
+        const int *nbrfirst, *order;
+        const unsigned int *nbr;
+        int i, chunk, tid, natoms, nthreads;
+
+        /* precompute some constants */
+        c12 = 4.0*epsilon*pow(sigma,12.0);
+        c6  = 4.0*epsilon*pow(sigma, 6.0);
+        rcut= atom->GetRadCut();
+        rcsq= rcut * rcut;
+        CutoffCoeffs(rcut, &ecut, &fcut);
+        sf = (style == LJ_SF);
+        natoms = atom->GetNAtoms();
+        nbrfirst = atom->GetCellNbrFirst();
+        nbr = atom->GetCellNbr();
+        order = atom->GetCellOrder();
+        epot = 0.0;
+        virial = 0.0;
+
+#if defined(_OPENMP)
+	nthreads=omp_get_num_threads();
+        tid=omp_get_thread_num();
+#else
+	nthreads=1;
+        tid=0;
+#endif
+        /* pair distances are binned into this thread's histogram, if requested */
+        hist = rdf ? rdf->GetHistogram(tid) : NULL;
+        rdfscale = rdf ? rdf->GetScale() : 0.0;
+        f=atom->GetForce();
+        rx=atom->GetPosition();
+        ry=atom->GetPosition() + natoms;
+        rz=atom->GetPosition() + 2*natoms;
+
+        /* each thread owns whole cells and computes the forces on their
+           atoms from all neighbors. neighbors are only read, so forces go
+           straight into the force array without per-thread copies. every
+           pair is visited from both sides, energy and virial count half.
+           the cells of a thread are a contiguous chunk in traversal order. */
+        chunk = 1 + (atom->GetNCells() / nthreads);
+        for (i=tid*chunk; i < (tid+1)*chunk && i < atom->GetNCells(); ++i) {
+            int c, j, n;
+            c = order[i];
+            n = atom->GetCellNAtoms(c);
+
+            for (j=0; j < n; ++j) {
+                int ii, q;
+                double fxi, fyi, fzi;
+
+                ii=atom->GetCellIndex(c,j);
+                fxi = fyi = fzi = 0.0;
+
+                for (q=nbrfirst[c]; q < nbrfirst[c+1]; ++q) {
+                    int k, c2, n2;
+                    double rx1, ry1, rz1;
+                    const double *shift;
+
+                    /* neighbor cell and image code are packed in one entry */
+                    c2 = nbr[q] >> cellpair_imagebits;
+                    shift = atom->GetImageShift(nbr[q] & ((1 << cellpair_imagebits) - 1));
+                    n2 = atom->GetCellNAtoms(c2);
+                    rx1=rx[ii] - shift[0];
+                    ry1=ry[ii] - shift[1];
+                    rz1=rz[ii] - shift[2];
+
+                    for (k=0; k < n2; ++k) {
+                        int jj;
+                        double rx2,ry2,rz2,rsq;
+
+                        jj=atom->GetCellIndex(c2,k);
+                        if (jj == ii) continue;
+                        rx2=rx1 - rx[jj];
+                        ry2=ry1 - ry[jj];
+                        rz2=rz1 - rz[jj];
+                        rsq = rx2*rx2 + ry2*ry2 + rz2*rz2;
+
+                        if (rsq < rcsq) {
+                            double r6,rinv,ffac;
+
+                            rinv=1.0/rsq;
+                            r6=rinv*rinv*rinv;
+
+                            ffac = (12.0*c12*r6 - 6.0*c6)*r6*rinv;
+                            epot += r6*(c12*r6 - c6) - ecut;
+                            if (sf) {
+                                double r = sqrt(rsq);
+                                ffac -= fcut/r;
+                                epot += fcut*(r - rcut);
+                            }
+                            virial += ffac*rsq;
+                            if (hist && ii < jj) ++hist[(int)(rsq*rdfscale)];
+
+                            fxi += rx2*ffac;
+                            fyi += ry2*ffac;
+                            fzi += rz2*ffac;
+                        }
+                    }
+                }
+                f[ii]          = fxi;
+                f[natoms+ii]   = fyi;
+                f[2*natoms+ii] = fzi;
+            }
+        }
+    }
+    epot *= 0.5;
+    virial *= 0.5;
+    StoreEnergies(atom, epot, virial);
+}
+
+
+bool Pair_LJ::UseAllPairs(Atoms *atom)
+{
+    int ncells;
+    double natoms, avg, cellchecks;
+
+    /* the kernel applies the minimum image per dimension */
+    if (!allpairs || atom->IsTriclinic() || atom->GetNCells() == 0) return false;
+
+    /* distance checks of the cell lists, at the average number of atoms per
+       cell, against all pairs. for few atoms or cells that are coarse for
+       the box these are about the same, and the vectorized all-pairs kernel
+       saves the cell bookkeeping. */
+    ncells = atom->GetNCells();
+    natoms = atom->GetNAtoms();
+    avg = natoms / ncells;
+    cellchecks = (atom->GetNActivePairs() + 0.5*ncells) * avg*avg;
+    return 0.5*natoms*natoms <= allpairs_ratio * cellchecks;
+}
+
+
+void Pair_LJ::ComputeForceAllPairs(Atoms *atom)
+{
+    double epot = 0.0, virial = 0.0;
+    int natoms, ntiles;
+
+    natoms = atom->GetNAtoms();
+    ntiles = (natoms + allpairs_tile-1) / allpairs_tile;
+
+    /* for the smallest systems, a parallel region costs more than the pairs */
+#if defined(_OPENMP)
+#pragma omp parallel reduction(+:epot,virial) if(natoms > allpairs_serial)
+#endif
+    {
+        double c12,c6,rcsq,rcut,ecut,fcut,rdfscale,lx,ly,lz,hx,hy,hz;
+        long *hist;
+        bool sf;
+        double *fx, *fy, *fz;
+        double *rx, *ry, *rz;
+        int i, t, ti, tj, tid, fromidx, toidx, nthreads;
+
+        /* precompute some constants */
+        c12 = 4.0*epsilon*pow(sigma,12.0);
+        c6  = 4.0*epsilon*pow(sigma, 6.0);
+        rcut= atom->GetRadCut();
+        rcsq= rcut * rcut;
+        CutoffCoeffs(rcut, &ecut, &fcut);
+        sf = (style == LJ_SF);
+        lx = atom->GetBoxSize(0);
+        ly = atom->GetBoxSize(1);
+        lz = atom->GetBoxSize(2);
+        hx = 0.5*lx;
+        hy = 0.5*ly;
+        hz = 0.5*lz;
+        epot = 0.0;
+        virial = 0.0;
+
+#if defined(_OPENMP)
+        nthreads=omp_get_num_threads();
+        tid=omp_get_thread_num();
+#else
+        nthreads=1;
+        tid=0;
+#endif
+        hist = rdf ? rdf->GetHistogram(tid) : NULL;
+        rdfscale = rdf ? rdf->GetScale() : 0.0;
+        fx=atom->GetForce() + (3*tid*natoms);
+        azzero(fx,3*natoms);
+        fy=atom->GetForce() + ((3*tid+1)*natoms);
+        fz=atom->GetForce() + ((3*tid+2)*natoms);
+        rx=atom->GetPosition();
+        ry=atom->GetPosition() + natoms;
+        rz=atom->GetPosition() + 2*natoms;
+
+        /* pairs of tiles (each with itself and the following ones) are
+           dealt out to the threads. positions and forces of the second
+           tile are kept in local arrays, which fit into the L1 cache and
+           cannot alias, and the inner loop has no branches, so the
+           compiler can vectorize it. */
+        t = 0;
+        for (ti=0; ti < ntiles; ++ti) {
+            for (tj=ti; tj < ntiles; ++tj, ++t) {
+                int j, iend, jbeg, nj;
+                double xj[allpairs_tile], yj[allpairs_tile], zj[allpairs_tile];
+                double fxj[allpairs_tile], fyj[allpairs_tile], fzj[allpairs_tile];
+
+                if (t % nthreads != tid) continue;
+                iend = (ti+1)*allpairs_tile;
+                if (iend > natoms) iend = natoms;
+                jbeg = tj*allpairs_tile;
+                nj = natoms - jbeg;
+                if (nj > allpairs_tile) nj = allpairs_tile;
+                for (j=0; j < nj; ++j) {
+                    xj[j] = rx[jbeg+j];
+                    yj[j] = ry[jbeg+j];
+                    zj[j] = rz[jbeg+j];
+                    fxj[j] = fyj[j] = fzj[j] = 0.0;
+                }
+
+                for (i=ti*allpairs_tile; i < iend; ++i) {
+                    int j0;
+                    double rx1, ry1, rz1, fxi, fyi, fzi;
+
+                    rx1=rx[i];
+                    ry1=ry[i];
+                    rz1=rz[i];
+                    fxi = fyi = fzi = 0.0;
+                    j0 = (ti == tj) ? i+1 - jbeg : 0;
+
+                    for (j=j0; j < nj; ++j) {
+                        double rx2,ry2,rz2,rsq,r6,rinv,ffac,e;
+
+                        /* minimum image. positions are wrapped at the last
+                           migration and stray less than a box length since */
+                        rx2 = rx1 - xj[j];
+                        ry2 = ry1 - yj[j];
+                        rz2 = rz1 - zj[j];
+                        rx2 = (rx2 >  hx) ? rx2 - lx : rx2;
+                        rx2 = (rx2 < -hx) ? rx2 + lx : rx2;
+                        ry2 = (ry2 >  hy) ? ry2 - ly : ry2;
+                        ry2 = (ry2 < -hy) ? ry2 + ly : ry2;
+                        rz2 = (rz2 >  hz) ? rz2 - lz : rz2;
+                        rz2 = (rz2 < -hz) ? rz2 + lz : rz2;
+                        rsq = rx2*rx2 + ry2*ry2 + rz2*rz2;
+
+                        rinv=1.0/rsq;
+                        r6=rinv*rinv*rinv;
+                        ffac = (12.0*c12*r6 - 6.0*c6)*r6*rinv;
+                        e = r6*(c12*r6 - c6) - ecut;
+                        if (sf) {
+                            double r = sqrt(rsq);
+                            ffac -= fcut/r;
+                            e += fcut*(r - rcut);
+                        }
+
+                        /* pairs beyond the cutoff are masked out */
+                        if (rsq >= rcsq) {
+                            ffac = 0.0;
+                            e = 0.0;
+                        }
+                        epot += e;
+                        virial += ffac*rsq;
+
+                        fxi += rx2*ffac;
+                        fyi += ry2*ffac;
+                        fzi += rz2*ffac;
+                        fxj[j] -= rx2*ffac;
+                        fyj[j] -= ry2*ffac;
+                        fzj[j] -= rz2*ffac;
+                    }
+                    fx[i] += fxi;
+                    fy[i] += fyi;
+                    fz[i] += fzi;
+
+                    /* pair distances for the radial distribution function */
+                    if (hist) {
+                        for (j=j0; j < nj; ++j) {
+                            double dr[3], rsq;
+
+                            dr[0] = rx1 - xj[j];
+                            dr[1] = ry1 - yj[j];
+                            dr[2] = rz1 - zj[j];
+                            atom->MinImage(dr);
+                            rsq = dr[0]*dr[0] + dr[1]*dr[1] + dr[2]*dr[2];
+                            if (rsq < rcsq) ++hist[(int)(rsq*rdfscale)];
+                        }
+                    }
+                }
+                for (j=0; j < nj; ++j) {
+                    fx[jbeg+j] += fxj[j];
+                    fy[jbeg+j] += fyj[j];
+                    fz[jbeg+j] += fzj[j];
+                }
+            }
+        }
+
+        /* before reducing the forces, we have to make sure
            that all threads are done adding to them. */
 #if defined (_OPENMP)
 #pragma omp barrier
@@ -171,21 +1192,224 @@ void Pair_LJ::ComputeForce(Atoms *atom)
         if (toidx > 3*natoms) toidx = 3*natoms;
 
         /* reduce forces from threads with tid != 0 into
-           the storage of the first thread. since we have
-           threads already spawned, we do this in parallel. */
+           the storage of the first thread */
         for (i=1; i < nthreads; ++i) {
             int offs, j;
+            double *frc = atom->GetForce();
 
             offs = 3*i*natoms;
 
             for (j=fromidx; j < toidx; ++j) {
-  //              atom->frc[j] += atom->frc[offs+j];
-	      atom->SetForce(j,atom->GetForce(j)+atom->GetForce(offs+j));
+                frc[j] += frc[offs+j];
+            }
+        }
+    }
+    StoreEnergies(atom, epot, virial);
+}
+
+
+void Pair_LJ::SelectList(Atoms *atom)
+{
+    listmode = LIST_HALF;
+
+#if defined(_OPENMP)
+    /* with several threads, time both kernels on the current positions
+       and keep the faster one for the rest of the run */
+    if (omp_get_max_threads() > 1 && !omp_in_parallel()) {
+        double thalf = HUGE_VAL, tfull = HUGE_VAL;
+        Rdf *keep = rdf;
+
+        rdf = NULL;
+        for (int t=0; t < listtrials; ++t) {
+            double t0 = omp_get_wtime();
+            ComputeForceHalf(atom);
+            thalf = fmin(thalf, omp_get_wtime() - t0);
+
+            t0 = omp_get_wtime();
+            ComputeForceFull(atom);
+            tfull = fmin(tfull, omp_get_wtime() - t0);
+        }
+        rdf = keep;
+
+        if (tfull < thalf) listmode = LIST_FULL;
+        printf("Using %s neighbor lists (%.3f ms half, %.3f ms full per force computation).\n",
+               (listmode == LIST_FULL) ? "full" : "half", 1000.0*thalf, 1000.0*tfull);
+    }
+#endif
+}
+
 
+void Pair_LJ::SelectLayout(Atoms *atom)
+{
+    const char *name[3] = { "soa", "aos", "aosoa" };
+    double t[3] = { HUGE_VAL, HUGE_VAL, HUGE_VAL };
+    Rdf *keep = rdf;
+    int l, best;
+
+    /* time the half list kernel on the current positions with each layout
+       and keep the fastest one for the rest of the run. all layouts give
+       the same forces, only the memory access pattern differs. */
+    rdf = NULL;
+    for (int trial=0; trial < listtrials; ++trial) {
+        for (l=0; l < 3; ++l) {
+            double t0;
+
+            layout = (l == 0) ? LAYOUT_SOA : (l == 1) ? LAYOUT_AOS : LAYOUT_AOSOA;
+            t0 = wallclock();
+            ComputeForceHalf(atom);
+            t[l] = fmin(t[l], wallclock() - t0);
+        }
+    }
+    rdf = keep;
+
+    best = 0;
+    for (l=1; l < 3; ++l) if (t[l] < t[best]) best = l;
+    layout = (best == 0) ? LAYOUT_SOA : (best == 1) ? LAYOUT_AOS : LAYOUT_AOSOA;
+    printf("Using %s layout (%.3f ms soa, %.3f ms aos, %.3f ms aosoa per force computation).\n",
+           name[best], 1000.0*t[0], 1000.0*t[1], 1000.0*t[2]);
+}
+
+
+double Pair_LJ::ComputeAtomEnergy(Atoms *atom, int idx, double x, double y, double z,
+                                  const std::vector<int> &cells)
+{
+    double c12,c6,rcsq,rcut,ecut,fcut,epot;
+    double *rx, *ry, *rz;
+    int i, k, natoms;
+
+    c12 = 4.0*epsilon*pow(sigma,12.0);
+    c6  = 4.0*epsilon*pow(sigma, 6.0);
+    rcut= atom->GetRadCut();
+    rcsq= rcut * rcut;
+    CutoffCoeffs(rcut, &ecut, &fcut);
+    natoms = atom->GetNAtoms();
+    rx=atom->GetPosition();
+    ry=atom->GetPosition() + natoms;
+    rz=atom->GetPosition() + 2*natoms;
+    epot = 0.0;
+
+    for (i=0; i < (int)cells.size(); ++i) {
+        int c = cells[i];
+
+        for (k=0; k < atom->GetCellNAtoms(c); ++k) {
+            int jj;
+            double d[3],rsq;
+
+            jj = atom->GetCellIndex(c,k);
+            if (jj == idx) continue;
+
+            d[0] = x - rx[jj];
+            d[1] = y - ry[jj];
+            d[2] = z - rz[jj];
+            atom->MinImage(d);
+            rsq = d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+
+            if (rsq < rcsq) {
+                double r6,rinv;
+
+                rinv=1.0/rsq;
+                r6=rinv*rinv*rinv;
+                epot += r6*(c12*r6 - c6) - ecut;
+                if (style == LJ_SF) epot += fcut*(sqrt(rsq) - rcut);
             }
         }
     }
-    atom->SetPotEnergy(epot);
+    return epot;
+}
+
+
+bool Pair_LJ::SetStyle(std::string _style)
+{
+    if (_style != "cut" && _style != "shift" && _style != "sf") {
+        std::cout << "( ERROR ) Pair_LJ::SetStyle(): unknown style '" << _style << "'. Abort!" << std::endl;
+        return false;
+    }
+    if (tail && _style != "cut") {
+        std::cout << "( ERROR ) Pair_LJ::SetStyle(): tail corrections only apply to the truncated potential. Abort!" << std::endl;
+        return false;
+    }
+    if (_style == "cut")        style = LJ_CUT;
+    else if (_style == "shift") style = LJ_SHIFT;
+    else                        style = LJ_SF;
+
+    //No error
+    return true;
+}
+
+bool Pair_LJ::SetList(std::string _list)
+{
+    if (_list == "half")      listmode = LIST_HALF;
+    else if (_list == "full") listmode = LIST_FULL;
+    else if (_list == "auto") listmode = LIST_AUTO;
+    else {
+        std::cout << "( ERROR ) Pair_LJ::SetList(): unknown neighbor list '" << _list << "'. Abort!" << std::endl;
+        return false;
+    }
+
+    //No error
+    return true;
+}
+
+bool Pair_LJ::SetLayout(std::string _layout)
+{
+    if (_layout == "soa")        layout = LAYOUT_SOA;
+    else if (_layout == "aos")   layout = LAYOUT_AOS;
+    else if (_layout == "aosoa") layout = LAYOUT_AOSOA;
+    else if (_layout == "auto")  layout = LAYOUT_AUTO;
+    else {
+        std::cout << "( ERROR ) Pair_LJ::SetLayout(): unknown layout '" << _layout << "'. Abort!" << std::endl;
+        return false;
+    }
+
+    //No error
+    return true;
+}
+
+bool Pair_LJ::SetAllPairs(bool _allpairs)
+{
+    allpairs = _allpairs;
+
+    //No error
+    return true;
 }
 
+bool Pair_LJ::SetTail(bool _tail)
+{
+    if (_tail && style != LJ_CUT) {
+        std::cout << "( ERROR ) Pair_LJ::SetTail(): tail corrections only apply to the truncated potential. Abort!" << std::endl;
+        return false;
+    }
+    tail = _tail;
+
+    //No error
+    return true;
+}
+
+void Pair_LJ::CutoffCoeffs(double rcut, double *ecut, double *fcut)
+{
+    double c12, c6, r6;
+
+    c12 = 4.0*epsilon*pow(sigma,12.0);
+    c6  = 4.0*epsilon*pow(sigma, 6.0);
+    r6  = 1.0/pow(rcut, 6.0);
 
+    *ecut = 0.0;
+    *fcut = 0.0;
+    if (style != LJ_CUT) *ecut = r6*(c12*r6 - c6);
+    if (style == LJ_SF)  *fcut = (12.0*c12*r6 - 6.0*c6)*r6/rcut;
+}
+
+void Pair_LJ::TailCorrection(Atoms *atom, double *etail, double *wtail)
+{
+    double rho, sr3, sr9, vol, natoms;
+
+    /* integrals of the potential and the virial beyond the cutoff with g(r)=1 */
+    natoms = atom->GetNAtoms();
+    vol = atom->GetVolume();
+    rho = natoms / vol;
+    sr3 = pow(sigma / atom->GetRadCut(), 3.0);
+    sr9 = sr3*sr3*sr3;
+
+    *etail = 8.0/3.0*M_PI*natoms*rho*epsilon*pow(sigma,3.0)*(sr9/3.0 - sr3);
+    *wtail = 16.0*M_PI*natoms*rho*epsilon*pow(sigma,3.0)*(2.0/3.0*sr9 - sr3);
+}
@@ -0,0 +1,75 @@
+/**
+ * Random
+ *
+ * @short This class provides a small, fast pseudo random number generator (xorshift64*) with uniform, gaussian and gamma deviates.
+ */
+
+#include "Random.h"
+
+
+/**
+ * (Re-)seed the generator
+ */
+void Random::Seed(uint64_t seed)
+{
+    /* scramble the seed (splitmix64), the state must not be zero */
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+    this->m_state = z ? z : 0x9E3779B97F4A7C15ULL;
+    this->m_hasgauss = false;
+    this->m_gauss = 0.0;
+};
+
+
+/**
+ * Gaussian deviate (Box-Muller, polar form)
+ */
+double Random::Gauss()
+{
+    double v1, v2, rsq, fac;
+
+    if (this->m_hasgauss) {
+        this->m_hasgauss = false;
+        return this->m_gauss;
+    }
+
+    do {
+        v1 = 2.0*this->Uniform() - 1.0;
+        v2 = 2.0*this->Uniform() - 1.0;
+        rsq = v1*v1 + v2*v2;
+    } while (rsq >= 1.0 || rsq == 0.0);
+
+    fac = sqrt(-2.0*log(rsq)/rsq);
+    this->m_gauss = v1*fac;
+    this->m_hasgauss = true;
+    return v2*fac;
+};
+
+
+/**
+ * Gamma deviate (Marsaglia and Tsang, ACM TOMS 26, 363 (2000))
+ */
+double Random::Gamma(double shape)
+{
+    double d, c, x, v, u;
+
+    /* boost small shapes: G(a) = G(a+1) * U^(1/a) */
+    if (shape < 1.0) {
+        return this->Gamma(shape + 1.0) * pow(this->Uniform(), 1.0/shape);
+    }
+
+    d = shape - 1.0/3.0;
+    c = 1.0/sqrt(9.0*d);
+    for (;;) {
+        do {
+            x = this->Gauss();
+            v = 1.0 + c*x;
+        } while (v <= 0.0);
+        v = v*v*v;
+        u = this->Uniform();
+        if (u < 1.0 - 0.0331*x*x*x*x) return d*v;
+        if (log(u) < 0.5*x*x + d*(1.0 - v + log(v))) return d*v;
+    }
+};
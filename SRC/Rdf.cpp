@@ -0,0 +1,105 @@
+/**
+ * Rdf
+ *
+ * @short This class accumulates the radial distribution function g(r) on the fly: the force kernel bins the squared distances of all pairs within the cutoff into per-thread histograms, which are merged when g(r) is written.
+ */
+
+#include "Rdf.h"
+
+
+/**
+ * Default constructor
+ */
+Rdf::Rdf() :
+    m_nbins(0),
+    m_scale(0),
+    m_nsamples(0),
+    m_hist(0),
+    m_total(0)
+{};
+
+/**
+ * Default destructor
+ */
+Rdf::~Rdf()
+{};
+
+/**
+ * Init
+ */
+bool Rdf::Init(int nbins, double rcut, int nthreads)
+{
+    if (nbins < 1 || rcut <= 0.0 || nthreads < 1) {
+        std::cout << "( ERROR ) Rdf::Init(): need a positive number of bins, cutoff and threads. Abort!" << std::endl;
+        return false;
+    }
+
+    this->m_nbins = nbins;
+    this->m_scale = nbins / (rcut*rcut);
+    this->m_hist.assign(nthreads, std::vector<long>(nbins+1, 0));
+    this->m_total.assign(nbins+1, 0);
+    this->m_nsamples = 0;
+
+    //No error
+    return true;
+};//Init
+
+
+/**
+ * Merge per-thread histograms
+ */
+void Rdf::Merge()
+{
+    for (unsigned int t=0; t < this->m_hist.size(); ++t) {
+        for (int i=0; i < this->m_nbins; ++i) {
+            this->m_total[i] += this->m_hist[t][i];
+            this->m_hist[t][i] = 0;
+        }
+        this->m_hist[t][this->m_nbins] = 0;
+    }
+};
+
+
+/**
+ * Write accumulated g(r)
+ */
+bool Rdf::Write(FILE *fp, Atoms *atom, int nfi)
+{
+    int i, natoms;
+    double rho, norm;
+
+    this->Merge();
+    natoms = atom->GetNAtoms();
+    rho = natoms / atom->GetVolume();
+
+    /* pairs are counted once, so each sample contributes N/2 reference atoms */
+    norm = (this->m_nsamples > 0) ? 2.0 / (this->m_nsamples * natoms * rho) : 0.0;
+
+    fprintf(fp, "# nfi=%d samples=%ld\n#            R                 G(R)\n", nfi, this->m_nsamples);
+    for (i=0; i < this->m_nbins; ++i) {
+        double rlo, rhi, shell;
+
+        /* bins are equally spaced in r^2 */
+        rlo = sqrt(i / this->m_scale);
+        rhi = sqrt((i+1) / this->m_scale);
+        shell = 4.0/3.0*M_PI*(rhi*rhi*rhi - rlo*rlo*rlo);
+        fprintf(fp, "% 20.8f % 20.8f\n", 0.5*(rlo + rhi), norm * this->m_total[i] / shell);
+    }
+    fprintf(fp, "\n\n");
+    fflush(fp);
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Clear histograms
+ */
+void Rdf::Reset()
+{
+    for (unsigned int t=0; t < this->m_hist.size(); ++t)
+        this->m_hist[t].assign(this->m_nbins+1, 0);
+    this->m_total.assign(this->m_nbins+1, 0);
+    this->m_nsamples = 0;
+};
@@ -0,0 +1,238 @@
+/**
+ * ReplicaExchange
+ *
+ * @short This class provides temperature replica exchange (parallel tempering) on top of the ensemble of replicas. Replicas advance in lock-step batches and exchange temperatures, not coordinates.
+ */
+
+#include "ReplicaExchange.h"
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+const double kboltz=0.0019872067;     /* boltzman constant in kcal/mol/K */
+
+
+/**
+ * Default constructor
+ */
+ReplicaExchange::ReplicaExchange() :
+    Ensemble(),
+    m_nexchange(0),
+    m_tau(0),
+    m_seed(0),
+    m_log(NULL),
+    m_temps(0),
+    m_rep2temp(0),
+    m_temp2rep(0),
+    m_thermostats(0),
+    m_attempts(0),
+    m_accepts(0),
+    m_random(1)
+{
+    m_logfile[0] = '\0';
+};
+
+/**
+ * Default destructor
+ */
+ReplicaExchange::~ReplicaExchange()
+{
+    //Release memory
+    for (unsigned int i=0; i<m_thermostats.size(); ++i) delete m_thermostats[i];
+    if (m_log) fclose(m_log);
+};
+
+
+/**
+ * Read replica exchange input
+ */
+bool ReplicaExchange::ReadInput(FILE *fp)
+{
+    char line[BLEN];
+
+    if(get_a_line(fp,line)) return false;
+    this->m_nexchange = atoi(line);
+    if(get_a_line(fp,line)) return false;
+    this->m_tau = atof(line);
+    if(get_a_line(fp,line)) return false;
+    this->m_seed = strtoul(line, NULL, 10);
+    if(get_a_line(fp,this->m_logfile)) return false;
+
+    if (this->m_nexchange <= 0) {
+        std::cout << "( ERROR ) ReplicaExchange::ReadInput(): exchange interval must be positive. Abort!" << std::endl;
+        return false;
+    }
+
+    /* one input deck and its temperature per line */
+    while (!feof(fp)) {
+        char fname[BLEN];
+        double temp;
+        FILE *deck;
+        MDParams params;
+        int c;
+
+        while ((c=fgetc(fp)) != EOF && isspace(c)) ;
+        if (c == EOF) break;
+        ungetc(c, fp);
+
+        if (get_a_line(fp, line)) return false;
+        if (line[0] == '\0') continue;
+        if (sscanf(line, "%s %lf", fname, &temp) != 2 || temp <= 0.0) {
+            std::cout << "( ERROR ) ReplicaExchange::ReadInput(): expected input deck and temperature, got '" << line << "'. Abort!" << std::endl;
+            return false;
+        }
+        if (!this->m_temps.empty() && temp <= this->m_temps.back()) {
+            std::cout << "( ERROR ) ReplicaExchange::ReadInput(): temperatures must be given in ascending order. Abort!" << std::endl;
+            return false;
+        }
+
+        deck = fopen(fname, "r");
+        if (!deck) {
+            std::cout << "( ERROR ) ReplicaExchange::ReadInput(): cannot open input deck " << fname << ". Abort!" << std::endl;
+            return false;
+        }
+        if (!MyMD::ReadInput(deck, &params)) {
+            std::cout << "( ERROR ) ReplicaExchange::ReadInput(): cannot parse input deck " << fname << ". Abort!" << std::endl;
+            fclose(deck);
+            return false;
+        }
+        fclose(deck);
+
+        if (!this->AddReplica(params)) return false;
+        this->m_temps.push_back(temp);
+    }
+
+    if (this->m_replicas.size() < 2) {
+        std::cout << "( ERROR ) ReplicaExchange::ReadInput(): need at least two replicas. Abort!" << std::endl;
+        return false;
+    }
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Setup replicas and attach thermostats
+ */
+bool ReplicaExchange::Setup()
+{
+    int i, nrep;
+
+    if (!Ensemble::Setup()) return false;
+
+    nrep = this->m_replicas.size();
+    for (i=0; i < nrep; ++i) {
+        Thermostat *t = new Thermostat();
+        t->Init(this->m_replicas[i]->atoms, this->m_seed + 1 + i);
+        t->SetTemp(this->m_temps[i]);
+        t->SetTau(this->m_tau);
+        this->m_replicas[i]->SetThermostat(t);
+        this->m_thermostats.push_back(t);
+        this->m_rep2temp.push_back(i);
+        this->m_temp2rep.push_back(i);
+    }
+    this->m_attempts.assign(nrep-1, 0);
+    this->m_accepts.assign(nrep-1, 0);
+    this->m_random.Seed(this->m_seed);
+
+    this->m_log = fopen(this->m_logfile, "w");
+    if (!this->m_log) {
+        perror("cannot open replica exchange log");
+        return false;
+    }
+    fprintf(this->m_log, "# replica at each temperature after exchange attempts\n#      NFI");
+    for (i=0; i < nrep; ++i) fprintf(this->m_log, " %8.2f", this->m_temps[i]);
+    fprintf(this->m_log, "\n");
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Run batches of MD steps with exchanges in between
+ */
+bool ReplicaExchange::Run()
+{
+    int i, nrep, nsteps, ndone, batch;
+    nrep = this->m_replicas.size();
+    nsteps = this->m_replicas[0]->params.nsteps;
+
+    for (i=0; i < nrep; ++i) this->m_replicas[i]->output();
+
+#if defined(_OPENMP)
+    /* one thread per replica: the force kernel of a replica runs with a team of one */
+    omp_set_max_active_levels(1);
+#endif
+
+    for (ndone=0, batch=0; ndone < nsteps; ++batch) {
+        int n = this->m_nexchange;
+        if (ndone + n > nsteps) n = nsteps - ndone;
+
+        /* replicas only synchronize at the end of each batch */
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic,1)
+#endif
+        for (i=0; i < nrep; ++i) {
+            this->m_replicas[i]->Step(n);
+        }
+        ndone += n;
+
+        /* alternate between even and odd pairs of neighboring temperatures */
+        this->Exchange(batch % 2);
+
+        fprintf(this->m_log, "% 10d", ndone);
+        for (i=0; i < nrep; ++i) fprintf(this->m_log, " %8d", this->m_temp2rep[i]);
+        fprintf(this->m_log, "\n");
+    }
+
+    /* exchange statistics */
+    printf("    TEMP-1      TEMP-2   ATTEMPTS    ACCEPTED      RATIO\n");
+    fprintf(this->m_log, "#    TEMP-1      TEMP-2   ATTEMPTS    ACCEPTED      RATIO\n");
+    for (i=0; i < nrep-1; ++i) {
+        double ratio = (this->m_attempts[i] > 0) ? (double)this->m_accepts[i]/this->m_attempts[i] : 0.0;
+        printf("% 10.2f  % 10.2f % 10ld  % 10ld  % 10.4f\n", this->m_temps[i], this->m_temps[i+1],
+               this->m_attempts[i], this->m_accepts[i], ratio);
+        fprintf(this->m_log, "# % 10.2f  % 10.2f % 10ld  % 10ld  % 10.4f\n", this->m_temps[i], this->m_temps[i+1],
+                this->m_attempts[i], this->m_accepts[i], ratio);
+    }
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Attempt Metropolis swaps between neighboring temperatures
+ */
+void ReplicaExchange::Exchange(int parity)
+{
+    int k, nrep;
+    nrep = this->m_replicas.size();
+
+    for (k=parity; k < nrep-1; k += 2) {
+        int a, b;
+        double beta1, beta2, delta;
+
+        a = this->m_temp2rep[k];
+        b = this->m_temp2rep[k+1];
+        beta1 = 1.0/(kboltz*this->m_temps[k]);
+        beta2 = 1.0/(kboltz*this->m_temps[k+1]);
+        delta = (beta1 - beta2) * (this->m_replicas[a]->atoms->GetPotEnergy()
+                                   - this->m_replicas[b]->atoms->GetPotEnergy());
+
+        ++this->m_attempts[k];
+        if (delta >= 0.0 || this->m_random.Uniform() < exp(delta)) {
+            /* swap temperatures, not coordinates */
+            this->m_thermostats[a]->ExchangeTemp(this->m_temps[k+1]);
+            this->m_thermostats[b]->ExchangeTemp(this->m_temps[k]);
+            this->m_temp2rep[k]   = b;
+            this->m_temp2rep[k+1] = a;
+            this->m_rep2temp[a] = k+1;
+            this->m_rep2temp[b] = k;
+            ++this->m_accepts[k];
+        }
+    }
+};
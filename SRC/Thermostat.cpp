@@ -0,0 +1,109 @@
+/**
+ * Thermostat
+ *
+ * @short This class provides stochastic velocity rescaling (Bussi, Donadio and Parrinello, J. Chem. Phys. 126, 014101 (2007)) applied after each integrator step
+ */
+
+#include "Thermostat.h"
+
+const double kboltz=0.0019872067;     /* boltzman constant in kcal/mol/K */
+
+
+/**
+ * Default constructor
+ */
+Thermostat::Thermostat() :
+    m_atom(NULL),
+    m_temperature(0),
+    m_tau(100.0),
+    m_random(1)
+{};
+
+/**
+ * Default destructor
+ */
+Thermostat::~Thermostat()
+{};
+
+/**
+ * Init
+ */
+bool Thermostat::Init(Atoms *atom, unsigned long seed)
+{
+    //Set pointers
+    if(!atom) {
+        std::cerr << "( ERROR ) Atoms null pointer... Abort Init!" << std::endl;
+        return false;
+    }
+    else this->m_atom = atom;
+
+    this->m_random.Seed(seed);
+
+    //No error
+    return true;
+};//Init
+
+
+/**
+ * Rescale velocities towards the target temperature.
+ * Requires the kinetic energy of the atoms to be up to date.
+ */
+bool Thermostat::Apply(double timestep)
+{
+    int i, nf;
+    double ekin, ekintarget, c, r1, sumsq, ekinnew, alpha;
+    double *v;
+
+    nf = 3 * this->m_atom->GetNAtoms() - 3;
+    ekin = this->m_atom->GetKinEnergy();
+    if (ekin <= 0.0 || nf < 1) return true;
+
+    ekintarget = 0.5 * nf * kboltz * this->m_temperature;
+    c = (this->m_tau > 0.0) ? exp(-timestep/this->m_tau) : 0.0;
+
+    /* new kinetic energy from the canonical distribution, relaxed with time constant tau */
+    r1 = this->m_random.Gauss();
+    sumsq = (nf > 1) ? 2.0*this->m_random.Gamma(0.5*(nf-1)) : 0.0;
+    ekinnew = ekin + (1.0 - c)*(ekintarget*(r1*r1 + sumsq)/nf - ekin)
+        + 2.0*r1*sqrt(c*(1.0 - c)*ekintarget*ekin/nf);
+    alpha = sqrt(ekinnew/ekin);
+    if (c < 1.0 && r1 + sqrt(c*nf*ekin/((1.0 - c)*ekintarget)) < 0.0) alpha = -alpha;
+
+    v = this->m_atom->GetVelocity();
+    for (i=0; i < 3*this->m_atom->GetNAtoms(); ++i) {
+        v[i] *= alpha;
+    }
+    this->m_atom->SetKinEnergy(ekin*alpha*alpha);
+    this->m_atom->SetTemp(this->m_atom->GetTemp()*alpha*alpha);
+
+    //No error
+    return true;
+};
+
+
+/**
+ * Change target temperature, rescaling velocities by sqrt(Tnew/Told)
+ */
+bool Thermostat::ExchangeTemp(double temp)
+{
+    int i;
+    double scale;
+    double *v;
+
+    if (this->m_temperature <= 0.0 || temp <= 0.0) {
+        std::cout << "( ERROR ) Thermostat::ExchangeTemp(): temperatures must be positive. Abort!" << std::endl;
+        return false;
+    }
+
+    scale = sqrt(temp/this->m_temperature);
+    v = this->m_atom->GetVelocity();
+    for (i=0; i < 3*this->m_atom->GetNAtoms(); ++i) {
+        v[i] *= scale;
+    }
+    this->m_atom->SetKinEnergy(this->m_atom->GetKinEnergy()*scale*scale);
+    this->m_atom->SetTemp(this->m_atom->GetTemp()*scale*scale);
+    this->m_temperature = temp;
+
+    //No error
+    return true;
+};
@@ -1,9 +1,146 @@
 #include "MyMD.h"
+#include "Ensemble.h"
+#include "ReplicaExchange.h"
 
-int main(int arg, char* argv[]){
-    MyMD* m = new MyMD();
+/* Kernel and potential options of the command line, applied to one run or
+   to every replica before its setup. */
+static bool SetOptions(MyMD *m, bool ghost, bool cluster, const std::string &ljstyle, bool tail,
+                       const std::string &list, const std::string &layout, bool allpairs,
+                       bool press, bool team){
+    m->integrator->SetGhost(ghost);
+    m->integrator->SetCluster(cluster);
+    if(!m->force->pair->LJ->SetStyle(ljstyle) || !m->force->pair->LJ->SetTail(tail)
+       || !m->force->pair->LJ->SetList(list) || !m->force->pair->LJ->SetLayout(layout)
+       || !m->force->pair->LJ->SetAllPairs(allpairs)) return false;
+    m->SetPrintPressure(press);
+    m->SetTeam(team);
+    return true;
+}
+
+int main(int argc, char* argv[]){
+    std::string minstyle = "", enslist = "", remdfile = "", ljstyle = "cut", list = "half", layout = "soa", rdffile = "", corrfile = "";
+    double ftol = -1.0, etol = -1.0, mctemp = -1.0, mcdisp = -1.0;
+    long mcseed = -1;
+    int rdfbins = 200, corrfreq = 1;
+    bool ghost = false, cluster = false, allpairs = true, tail = false, press = false, mem = false, team = true;
+    MDParams params;
+
+    /* Command line options: [-min fire|cg] [-ftol <force>] [-etol <rel. energy>]
+       [-mc <temp>] [-mcdisp <length>] [-mcseed <seed>] [-ghost] [-cluster] [-list half|full|auto] [-layout soa|aos|aosoa|auto]
+       [-noallpairs] [-noteam] [-lj cut|shift|sf] [-tail] [-press] [-mem] [-rdf <file>] [-rdfbins <n>] [-corr <file>] [-corrfreq <n>] [-ensemble <list>] [-remd <input>] */
+    for(int i=1; i<argc; ++i) {
+        std::string arg = argv[i];
+        if(arg=="-min" && i+1<argc) minstyle = argv[++i];
+        else if(arg=="-ensemble" && i+1<argc) enslist = argv[++i];
+        else if(arg=="-remd" && i+1<argc) remdfile = argv[++i];
+        else if(arg=="-ftol" && i+1<argc) ftol = atof(argv[++i]);
+        else if(arg=="-etol" && i+1<argc) etol = atof(argv[++i]);
+        else if(arg=="-ghost") ghost = true;
+        else if(arg=="-cluster") cluster = true;
+        else if(arg=="-lj" && i+1<argc) ljstyle = argv[++i];
+        else if(arg=="-list" && i+1<argc) list = argv[++i];
+        else if(arg=="-layout" && i+1<argc) layout = argv[++i];
+        else if(arg=="-noallpairs") allpairs = false;
+        else if(arg=="-noteam") team = false;
+        else if(arg=="-tail") tail = true;
+        else if(arg=="-press") press = true;
+        else if(arg=="-mem") mem = true;
+        else if(arg=="-rdf" && i+1<argc) rdffile = argv[++i];
+        else if(arg=="-rdfbins" && i+1<argc) rdfbins = atoi(argv[++i]);
+        else if(arg=="-corr" && i+1<argc) corrfile = argv[++i];
+        else if(arg=="-corrfreq" && i+1<argc) corrfreq = atoi(argv[++i]);
+        else if(arg=="-mc" && i+1<argc) mctemp = atof(argv[++i]);
+        else if(arg=="-mcdisp" && i+1<argc) mcdisp = atof(argv[++i]);
+        else if(arg=="-mcseed" && i+1<argc) mcseed = atol(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [-ghost|-cluster] [-list half|full|auto] [-layout soa|aos|aosoa|auto]\n"
+                    "          [-noallpairs] [-noteam] [-lj cut|shift|sf] [-tail] [-press] [-mem]\n"
+                    "          [-rdf <file> [-rdfbins <n>]] [-corr <file> [-corrfreq <n>]]\n"
+                    "          [-min fire|cg] [-ftol <force>] [-etol <rel. energy>] < input\n"
+                    "       %s -mc <temp> [-mcdisp <length>] [-mcseed <seed>] < input\n"
+                    "       %s -ensemble <list of input decks>\n"
+                    "       %s -remd <replica exchange input>\n", argv[0], argv[0], argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+    if(ghost && cluster) {
+        fprintf(stderr, "%s: -ghost and -cluster cannot be combined\n", argv[0]);
+        return 1;
+    }
+
+    /* Replicas run MD with per replica output files: options for other
+       runs or single output files are refused rather than ignored. */
+    if((!remdfile.empty() || !enslist.empty())
+       && (!minstyle.empty() || mctemp > 0.0 || !rdffile.empty() || !corrfile.empty() || mem)) {
+        fprintf(stderr, "%s: -min, -mc, -rdf, -corr and -mem cannot be combined with %s\n",
+                argv[0], remdfile.empty() ? "-ensemble" : "-remd");
+        return 1;
+    }
+
+    /* Replica exchange: thermostatted replicas swapping temperatures. */
+    if(!remdfile.empty()) {
+        ReplicaExchange remd;
+        FILE *fp = fopen(remdfile.c_str(), "r");
+        if(!fp) {
+            perror("cannot read replica exchange input");
+            return 1;
+        }
+        bool ok = remd.ReadInput(fp);
+        fclose(fp);
+        for(int i=0; ok && i<remd.GetNReplicas(); ++i)
+            ok = SetOptions(remd.GetReplica(i), ghost, cluster, ljstyle, tail, list, layout, allpairs, press, team);
+        if(!ok || !remd.Setup()) return 1;
+        printf("Running replica exchange with %d replicas.\n", remd.GetNReplicas());
+        remd.Run();
+        return 0;
+    }
+
+    /* Ensemble mode: independent replicas, one input deck per line in the list. */
+    if(!enslist.empty()) {
+        Ensemble ens;
+        FILE *fp = fopen(enslist.c_str(), "r");
+        if(!fp) {
+            perror("cannot read ensemble list");
+            return 1;
+        }
+        bool ok = ens.ReadList(fp);
+        fclose(fp);
+        for(int i=0; ok && i<ens.GetNReplicas(); ++i)
+            ok = SetOptions(ens.GetReplica(i), ghost, cluster, ljstyle, tail, list, layout, allpairs, press, team);
+        if(!ok || !ens.Setup()) return 1;
+        printf("Running ensemble of %d replicas.\n", ens.GetNReplicas());
+        ens.Run();
+        return 0;
+    }
+
+    /* Read input deck and restart, open output files. */
+    if(!MyMD::ReadInput(stdin, &params)) return 1;
+    MyMD* m = new MyMD(params);
+#if defined(_OPENMP)
+    printf("Running OpenMP version using %d threads\n", m->nthreads);
+#endif
+    if(!m->ReadRestart(params.restfile)) return 1;
+    if(!m->OpenFiles()) return 1;
+    if(!SetOptions(m, ghost, cluster, ljstyle, tail, list, layout, allpairs, press, team)) return 1;
+    if(!rdffile.empty() && !m->OpenRdf(rdffile.c_str(), rdfbins)) return 1;
+    if(!corrfile.empty() && !m->OpenCorrelators(corrfile.c_str(), corrfreq)) return 1;
+    if(!m->Setup()) return 1;
+    if(mem) m->atoms->PrintMemory(stdout);
     
-    m->MDLoop();
+    if(mctemp > 0.0) {
+        m->montecarlo->SetTemp(mctemp);
+        if(mcdisp > 0.0) m->montecarlo->SetMaxDisp(mcdisp);
+        if(mcseed >= 0) m->montecarlo->SetSeed(mcseed);
+        m->MonteCarloLoop();
+    } else if(minstyle.empty()) {
+        m->MDLoop();
+    } else {
+        if(ftol >= 0.0) m->minimizer->SetForceTol(ftol);
+        if(etol >= 0.0) m->minimizer->SetEnergyTol(etol);
+        m->Minimize(minstyle);
+    }
     
+    delete m;
     return 0;
 }
@@ -12,11 +12,49 @@ import subprocess
 import numpy as np
 
 from ase.atoms import Atoms
+from ase.calculators.calculator import Calculator, all_changes
 from ase.calculators.calculator import FileIOCalculator, Parameters, ReadError
+import ase.units as units
 
 import potentials
 import io
 
+# In-process interface to the MyMD library (optional, needs Cython)
+try:
+    from interface import System
+except ImportError:
+    System = None
+
+
+def get_box(cell):
+    """ Box parameters of MyMD for an ASE cell
+
+    Returns [L] for a cubic cell, [lx, ly, lz] for an orthorhombic cell and
+    [lx, ly, lz, xy, xz, yz] otherwise. The cell vectors must be
+    a = (lx, 0, 0), b = (xy, ly, 0), c = (xz, yz, lz).
+    """
+    cell = np.asarray(cell, dtype=float)
+    if cell.shape != (3, 3) or cell[0, 1] != 0.0 or cell[0, 2] != 0.0 \
+            or cell[1, 2] != 0.0:
+        raise RuntimeError("Unsupported cell: a must be along x and b "
+                           "in the xy-plane")
+    lx, ly, lz = cell[0, 0], cell[1, 1], cell[2, 2]
+    xy, xz, yz = cell[1, 0], cell[2, 0], cell[2, 1]
+    if xy != 0.0 or xz != 0.0 or yz != 0.0:
+        return [lx, ly, lz, xy, xz, yz]
+    if lx == ly == lz:
+        return [lx]
+    return [lx, ly, lz]
+
+
+def get_cell(box):
+    """ ASE cell for MyMD box parameters (1, 3 or 6 numbers) """
+    if len(box) == 1:
+        box = [box[0]] * 3
+    lx, ly, lz = box[:3]
+    xy, xz, yz = box[3:] if len(box) == 6 else (0.0, 0.0, 0.0)
+    return [[lx, 0.0, 0.0], [xy, ly, 0.0], [xz, yz, lz]]
+
 
 class FileIOMyMD(FileIOCalculator):
     """ ASE calculator for MyMD
@@ -188,8 +226,8 @@ class FileIOMyMD(FileIOCalculator):
         s += "{:<18f}# LJ-epsilon [kcal/mol]\n".format(ljpot.epsilon)
         s += "{:<18f}# LJ-sigma [kcal/mol]\n".format(ljpot.sigma)
         s += "{:<18f}# LJ-cutoff radius [kcal/mol]\n".format(ljpot.rcut)
-        s += "{:<18f}# box length [Angstroms]\n".format(
-            self.get_box_length(atoms.cell))
+        s += "{:<18s}# box length [Angstroms]\n".format(
+            " ".join("{:f}".format(b) for b in get_box(atoms.cell)))
         s += "{:<18s}# restart filename\n".format(p.restart)
         s += "{:<18s}# trajectory filename\n".format(self.label + '.xyz')
         s += "{:<18s}# energies filename\n".format(self.label + '.dat')
@@ -240,7 +278,7 @@ class FileIOMyMD(FileIOCalculator):
             epsilon = float(parse(s[2]))
             sigma = float(parse(s[3]))
             rcut = float(parse(s[4]))
-            box = parse(s[5])
+            box = [float(b) for b in s[5].split('#')[0].split()]
             restfile = parse(s[6])
             trajfile = parse(s[7])
             enerfile = parse(s[8])
@@ -250,7 +288,7 @@ class FileIOMyMD(FileIOCalculator):
             # TODO: start parsing the format...
 
         atoms = io.read_restart(label + '.rest')
-        atoms.set_cell([box, box, box])
+        atoms.set_cell(get_cell(box))
 
         if len(atoms) != natoms:
             s = "natoms = {} from {} does not match with\n".\
@@ -306,14 +344,6 @@ class FileIOMyMD(FileIOCalculator):
         self.results['potential energy'] = l.epot
         self.results['total energy'] = l.etot
 
-    def get_box_length(self, cell):
-        """Returns box length for cubic cell"""
-        if len(cell) == 3:
-            scp = np.dot(cell[0], cell[0])
-            return np.sqrt(scp)
-        else:
-            raise RuntimeError("Unknown cell type")
-
     def parse_line(self, string):
         return (string.split(' '))[0]
 
@@ -326,3 +356,89 @@ class FileIOMyMD(FileIOCalculator):
         except Exception:
             self.reset()
             raise
+
+
+class MyMD(Calculator):
+    """ In-process ASE calculator for MyMD
+
+    Unlike FileIOMyMD, this calculator does not write input files or
+    spawn the MyMD binary. It holds a MyMD simulation in memory
+    (interface.System) whose positions, velocities and forces are
+    NumPy views of the C++ arrays.
+
+    Specific for this calculator are
+
+        system                  interface.System holding the simulation
+        parameters.potentials   Potentials used to calculate forces
+        parameters.dt           MD time step [fs]
+
+    Energies are converted from kcal/mol to eV.
+    """
+
+    implemented_properties = ['energy', 'forces']
+
+    default_parameters = dict(
+        potentials=[potentials.LJPotential()],
+        dt=5.0,
+    )
+
+    # kcal/mol in eV
+    energy_unit = units.kcal / units.mol
+
+    def __init__(self, label='mymd', atoms=None, **kwargs):
+        if System is None:
+            raise RuntimeError('The MyMD interface module is not built. '
+                               'Install Cython and NumPy and run setup.py.')
+        self.system = None
+        Calculator.__init__(self, label=label, atoms=atoms, **kwargs)
+
+    def set(self, **kwargs):
+        changed_parameters = Calculator.set(self, **kwargs)
+        if changed_parameters:
+            self.reset()
+            self.system = None
+
+    def setup_system(self, atoms):
+        """ Create the in-memory MyMD simulation for atoms """
+        p = self.parameters
+        ljpot = p.potentials[0]
+
+        mlist = atoms.get_masses()
+        if np.min(mlist) < 0.999 * np.max(mlist):
+            s = "Different masses detected.\n"
+            s += "Currently, only a single kind of atom is supported."
+            raise RuntimeError(s)
+
+        self.system = System(len(atoms), mlist[0], ljpot.epsilon,
+                             ljpot.sigma, ljpot.rcut,
+                             get_box(atoms.get_cell()), p.dt)
+
+    def calculate(self, atoms=None, properties=['energy'],
+                  system_changes=all_changes):
+        Calculator.calculate(self, atoms, properties, system_changes)
+
+        if self.system is None or 'numbers' in system_changes or \
+                'cell' in system_changes:
+            self.setup_system(self.atoms)
+
+        self.system.positions[:] = self.atoms.get_positions()
+        self.system.compute_force()
+
+        self.results['energy'] = \
+            self.system.potential_energy * self.energy_unit
+        self.results['forces'] = \
+            self.system.forces.copy() * self.energy_unit
+
+    def run_md(self, atoms, nsteps):
+        """ Run nsteps of MD on atoms in memory and update atoms """
+        self.calculate(atoms, ['energy', 'forces'])
+        # MyMD velocities are in Angstrom/fs
+        self.system.velocities[:] = atoms.get_velocities() * units.fs
+        self.system.step(nsteps)
+        atoms.set_positions(self.system.positions)
+        atoms.set_velocities(self.system.velocities / units.fs)
+        self.results['energy'] = \
+            self.system.potential_energy * self.energy_unit
+        self.results['forces'] = \
+            self.system.forces.copy() * self.energy_unit
+        self.atoms = atoms.copy()
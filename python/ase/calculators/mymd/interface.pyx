@@ -1,5 +1,4 @@
 # distutils: language = c++
-# distutils: sources = MyMD.cpp
 """ Defines interface to MyMD C++ library
 
 This module implements the interface to C++ classes and functions
@@ -7,36 +6,196 @@ within MyMD that allow to interface the MyMD library directly.
 This allows a much higher level of flexibility than communicating
 with the binary via an input file.
 
+Positions, velocities and forces of the atoms are exposed as NumPy
+arrays of shape (natoms, 3) that share memory with the C++ Atoms
+class, i.e. no data is copied in either direction. Writing to these
+arrays changes the state of the simulation.
+
 This interface was created following the tutorial on
 http://docs.cython.org/src/userguide/wrapping_CPlusPlus.html
 
 """
 import cython
+import numpy as np
+cimport numpy as np
+from cpython.ref cimport Py_INCREF
+
+np.import_array()
+
+
+cdef extern from "Atoms.h" nogil:
+    cdef cppclass Atoms:
+        int GetNAtoms()
+        double* GetPosition()
+        double* GetVelocity()
+        double* GetForce()
+        double GetImageOffset(int idx)
+        double GetBoxWidth(int dim)
+        void ClearImages()
 
+cdef extern from "MyMD.h" nogil:
+    cdef struct MDParams:
+        int natoms
+        double mass
+        double epsilon
+        double sigma
+        double rcut
+        double box[3]
+        double tilt[3]
+        int nsteps
+        double dt
+        int nprint
+
+    cdef struct MDEnergies:
+        int nfi
+        double temp, ekin, epot, etot, press
 
-#class MyMD {
-#  public:
-#    /* Variables */
-#    Integrator *integrator;
-#    Force *force;
-#    Atom *atom;
-#
-#    /* Methods */
-#    void MyMD();
-#    void ~MyMD();
-#    void MDLoop();
-#  private:
-#    void readInput();
-#    void allocateMemory();
-#    void readRestart():
-#}
-
-cdef extern from "../../../../INC/MyMD.h":
     cdef cppclass MyMD:
-        MyMD() except +
-        void MDLoop()
-        void readInput()
-        void allocateMemory()
-        void readRestart()
+        MyMD(const MDParams &p) except +
+        Atoms *atoms
+        int nfi
+        bint Setup()
+        void Step(int n)
+        MDEnergies GetEnergies()
+
+
+cdef class System:
+    """ A MyMD simulation held in memory
+
+    Parameters
+        natoms      number of atoms
+        mass        atomic mass [AMU]
+        epsilon     LJ-epsilon [kcal/mol]
+        sigma       LJ-sigma [Angstrom]
+        rcut        LJ-cutoff radius [Angstrom]
+        box         box length [Angstrom]: a number (cubic), three lengths
+                    (orthorhombic) or lx, ly, lz, xy, xz, yz (triclinic)
+        dt          MD time step [fs]
+    """
+    cdef MyMD *md
+    cdef readonly int natoms
+
+    def __cinit__(self, int natoms, double mass, double epsilon,
+                  double sigma, double rcut, box, double dt=5.0):
+        cdef MDParams p
+        cdef int d
+        self.md = NULL
+        if natoms <= 0:
+            raise ValueError("number of atoms must be positive")
+        box = np.atleast_1d(np.asarray(box, dtype=float))
+        if box.size == 1:
+            box = np.repeat(box, 3)
+        if box.size == 3:
+            box = np.concatenate([box, np.zeros(3)])
+        if box.size != 6:
+            raise ValueError("box needs 1, 3 or 6 numbers")
+
+        p.natoms = natoms
+        p.mass = mass
+        p.epsilon = epsilon
+        p.sigma = sigma
+        p.rcut = rcut
+        for d in range(3):
+            p.box[d] = box[d]
+            p.tilt[d] = box[3+d]
+        p.dt = dt
+        p.nsteps = 0
+        # no output sinks are registered, so nothing is written
+        p.nprint = 0
+        self.md = new MyMD(p)
+        self.natoms = natoms
+        for d in range(3):
+            if rcut >= 0.5*self.md.atoms.GetBoxWidth(d):
+                raise ValueError("cutoff must be smaller than half the box width")
+
+    def __dealloc__(self):
+        if self.md != NULL:
+            del self.md
+
+    cdef object _view(self, double *data):
+        """ Wrap a planar (x..., y..., z...) array as (natoms, 3) view """
+        cdef np.npy_intp dims[2]
+        cdef np.ndarray arr
+        dims[0] = 3
+        dims[1] = self.natoms
+        arr = np.PyArray_SimpleNewFromData(2, dims, np.NPY_DOUBLE, <void*>data)
+        # keep this object alive as long as the view exists
+        Py_INCREF(self)
+        np.PyArray_SetBaseObject(arr, self)
+        return arr.T
+
+    property positions:
+        """ Atomic positions [Angstrom], shares memory with MyMD
+
+        Positions are wrapped into the box (fractional coordinates in
+        [-1/2, 1/2)) whenever atoms are sorted into cells.
+        """
+        def __get__(self):
+            return self._view(self.md.atoms.GetPosition())
+
+    property unwrapped_positions:
+        """ Atomic positions [Angstrom] with the wrapping into the box undone (copy) """
+        def __get__(self):
+            cdef int i
+            pos = np.array(self._view(self.md.atoms.GetPosition()))
+            shift = np.empty((3, self.natoms))
+            for i in range(3*self.natoms):
+                shift[i // self.natoms, i % self.natoms] = self.md.atoms.GetImageOffset(i)
+            return pos + shift.T
+
+    property velocities:
+        """ Atomic velocities [Angstrom/fs], shares memory with MyMD """
+        def __get__(self):
+            return self._view(self.md.atoms.GetVelocity())
+
+    property forces:
+        """ Atomic forces [kcal/mol/Angstrom], shares memory with MyMD """
+        def __get__(self):
+            return self._view(self.md.atoms.GetForce())
+
+    property potential_energy:
+        def __get__(self):
+            return self.md.GetEnergies().epot
+
+    property kinetic_energy:
+        def __get__(self):
+            return self.md.GetEnergies().ekin
+
+    property temperature:
+        def __get__(self):
+            return self.md.GetEnergies().temp
+
+    property pressure:
+        """ Pressure [atm] from the kinetic energy and the virial """
+        def __get__(self):
+            return self.md.GetEnergies().press
+
+    property nfi:
+        def __get__(self):
+            return self.md.nfi
+
+    def compute_force(self):
+        """ Compute forces and energies for the current positions
+
+        Positions may have been changed arbitrarily, so atoms are
+        sorted into cells before the forces are computed. This resets
+        the step counter and the periodic image counters: unwrapped
+        positions are counted from the current positions on.
+        """
+        cdef bint ok
+        with nogil:
+            self.md.atoms.ClearImages()
+            ok = self.md.Setup()
+        if not ok:
+            raise RuntimeError("MyMD setup failed")
+        return self.md.GetEnergies().epot
+
+    def step(self, int n=1):
+        """ Propagate the system by n velocity Verlet steps
 
-cdef MyMD *m = new MyMD()
+        Requires valid forces, i.e. compute_force() must have been
+        called after the positions were last modified from Python.
+        """
+        with nogil:
+            self.md.Step(n)
+        return self.md.GetEnergies().etot
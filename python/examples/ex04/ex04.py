@@ -0,0 +1,31 @@
+""" Example 04
+
+This example runs MyMD in memory through the interface module and
+checks that the unwrapped positions follow positions written from
+Python: every compute_force() starts counting periodic images anew.
+"""
+import numpy as np
+from ase.calculators.mymd import interface
+
+# 108 argon atoms on an fcc lattice in a cube of 17.158 Angstrom
+box = 17.158
+cells = 3
+a = box / cells
+basis = np.array([[0, 0, 0], [0.5, 0.5, 0], [0.5, 0, 0.5], [0, 0.5, 0.5]])
+grid = np.array([[i, j, k] for i in range(cells) for j in range(cells) for k in range(cells)])
+lattice = ((grid[:, None, :] + basis[None, :, :]) * a).reshape(-1, 3) - 0.5*box
+
+system = interface.System(108, 39.948, 0.2379, 3.405, 8.5, box, 5.0)
+
+# write positions twice, shifted out of the box by some box lengths,
+# with MD steps in between
+rng = np.random.RandomState(42)
+for shift in (1, -2):
+    pos = lattice + shift*box + rng.uniform(-0.1, 0.1, lattice.shape)
+    system.positions[:] = pos
+    system.velocities[:] = 0.0
+    system.compute_force()
+    err = np.abs(system.unwrapped_positions - pos).max()
+    print("box shift {:2d}: max error of unwrapped positions {:.3e} Angstrom".format(shift, err))
+    assert err < 1.0e-8
+    system.step(20)
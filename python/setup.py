@@ -1,6 +1,30 @@
 #!/usr/bin/env python
 
 from distutils.core import setup
+from distutils.extension import Extension
+
+# The in-process interface to the MyMD library is optional and
+# requires Cython and NumPy. Without them, only the file based
+# calculator is installed.
+try:
+    import numpy
+    from Cython.Distutils import build_ext
+except ImportError:
+    ext_modules = []
+    cmdclass = {}
+else:
+    mymd_src = ['MyMD.cpp', 'Atoms.cpp', 'Force.cpp', 'Helper.cpp',
+                'Integrator.cpp', 'Minimizer.cpp', 'MonteCarlo.cpp', 'Thermostat.cpp',
+                'Random.cpp', 'Rdf.cpp', 'Correlator.cpp', 'ClusterList.cpp', 'Pair.cpp', 'Pair_LJ.cpp']
+    ext_modules = [
+        Extension('ase.calculators.mymd.interface',
+                  sources=['ase/calculators/mymd/interface.pyx'] +
+                  ['../SRC/' + s for s in mymd_src],
+                  include_dirs=['../INC', numpy.get_include()],
+                  extra_compile_args=['-O3', '-ffast-math'],
+                  language='c++'),
+    ]
+    cmdclass = {'build_ext': build_ext}
 
 setup(
     name='MyMD Python Frontend',
@@ -11,4 +35,6 @@ setup(
     #      url='http://www.python.org/sigs/distutils-sig/',
     packages=['ase.calculators.mymd'],
 #      py_modules=['mymd'],
+    ext_modules=ext_modules,
+    cmdclass=cmdclass,
 )